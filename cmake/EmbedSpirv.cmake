@@ -0,0 +1,46 @@
+# Writes a C++ header that embeds compiled SPIR-V as uint32_t arrays.
+#
+#   cmake -DOUTPUT=<header> -DINPUTS=<a.spv|b.spv|...> -P EmbedSpirv.cmake
+#
+# INPUTS is '|'-separated because ';' does not survive add_custom_command.
+# Each shader becomes an EmbeddedShader entry named after its file, e.g. "hud.vert.spv".
+
+string(REPLACE "|" ";" INPUTS "${INPUTS}")
+
+set(CONTENT "// Generated by cmake/EmbedSpirv.cmake - do not edit\n\n")
+string(APPEND CONTENT "#pragma once\n\n#include <cstddef>\n#include <cstdint>\n\n")
+string(APPEND CONTENT "struct EmbeddedShader {\n    const char* name;\n    const uint32_t* code;\n    size_t size;   // bytes\n};\n\n")
+
+# 8 words per line; CMake regexes have no {n} repetition
+string(REPEAT "0x[0-9a-f]+u, " 7 LINE_WORDS)
+
+set(TABLE "")
+foreach(INPUT ${INPUTS})
+    get_filename_component(NAME ${INPUT} NAME)
+    string(MAKE_C_IDENTIFIER "spirv_${NAME}" SYMBOL)
+
+    file(READ ${INPUT} HEX HEX)
+    string(LENGTH "${HEX}" HEX_LENGTH)
+    math(EXPR REMAINDER "${HEX_LENGTH} % 8")
+    if(HEX_LENGTH EQUAL 0 OR NOT REMAINDER EQUAL 0)
+        message(FATAL_ERROR "${INPUT} is not a whole number of SPIR-V words")
+    endif()
+
+    # SPIR-V words are little-endian on disk; emit them as host-order literals
+    string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1u, " WORDS "${HEX}")
+    string(REGEX REPLACE "(${LINE_WORDS}0x[0-9a-f]+u,) " "\\1\n    " WORDS "${WORDS}")
+    string(STRIP "${WORDS}" WORDS)
+
+    string(APPEND CONTENT "static const uint32_t ${SYMBOL}[] = {\n    ${WORDS}\n};\n\n")
+    string(APPEND TABLE "    {\"${NAME}\", ${SYMBOL}, sizeof(${SYMBOL})},\n")
+endforeach()
+
+string(APPEND CONTENT "static const EmbeddedShader EMBEDDED_SHADERS[] = {\n${TABLE}};\n")
+
+# Only touch the header when it changes, so unrelated shader rebuilds don't force a recompile
+if(EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} OLD_CONTENT)
+endif()
+if(NOT "${CONTENT}" STREQUAL "${OLD_CONTENT}")
+    file(WRITE ${OUTPUT} "${CONTENT}")
+endif()
@@ -1,12 +1,16 @@
 #version 450
 
-layout(push_constant) uniform PushConstants {
-    mat4 mvp;
-    vec4 color;
-} pc;
+layout(set = 1, binding = 0) uniform sampler2D fontAtlas;
+
+layout(location = 0) in vec2 fragUV;
+layout(location = 1) in vec4 fragColor;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = pc.color;
+    // Signed distance field: 0.5 is the glyph edge, fwidth keeps it ~1px wide at any size
+    float d = texture(fontAtlas, fragUV).r;
+    float w = max(fwidth(d), 1e-4);
+    float alpha = smoothstep(0.5 - w, 0.5 + w, d);
+    outColor = vec4(fragColor.rgb, fragColor.a * alpha);
 }
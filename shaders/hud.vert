@@ -6,7 +6,14 @@ layout(push_constant) uniform PushConstants {
 } pc;
 
 layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inUV;      // font atlas coords, R16G16 UNORM
+layout(location = 2) in vec4 inColor;   // RGBA8 UNORM, per vertex
+
+layout(location = 0) out vec2 fragUV;
+layout(location = 1) out vec4 fragColor;
 
 void main() {
     gl_Position = pc.mvp * vec4(inPosition, 0.0, 1.0);
+    fragUV = inUV;
+    fragColor = inColor * pc.color;
 }
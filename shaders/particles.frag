@@ -6,11 +6,20 @@ layout(push_constant) uniform PushConstants {
 } pc;
 
 layout(location = 0) in float fragLife;
+layout(location = 1) in float fragKind;
 layout(location = 0) out vec4 outColor;
 
+#ifdef INSTANCED_QUAD
+layout(location = 2) in vec2 fragCorner;   // -1..1 across the quad
+#endif
+
 void main() {
-    // Circular point sprite
+    // Circular sprite
+#ifdef INSTANCED_QUAD
+    vec2 coord = fragCorner;
+#else
     vec2 coord = gl_PointCoord * 2.0 - 1.0;
+#endif
     float dist = dot(coord, coord);
     if (dist > 1.0) discard;
 
@@ -29,5 +38,15 @@ void main() {
     }
 
     float alpha = fragLife * (1.0 - dist) * pc.color.a;
+
+    if (fragKind > 1.5) {
+        // Crash debris: glowing metal cooling to dark grey, stays opaque while it tumbles
+        color = mix(vec3(0.25, 0.24, 0.24), warmColor, fragLife);
+        alpha = min(fragLife * 4.0, 1.0) * (1.0 - dist * 0.5) * pc.color.a;
+    } else if (fragKind > 0.5) {
+        // Regolith dust: flat grey that fades out slowly instead of cooling
+        color = vec3(0.55, 0.53, 0.5);
+        alpha = min(fragLife * 2.0, 1.0) * (1.0 - dist) * 0.6 * pc.color.a;
+    }
     outColor = vec4(color, alpha);
 }
@@ -3,16 +3,37 @@
 layout(push_constant) uniform PushConstants {
     mat4 mvp;
     vec4 color;
+    vec4 params;    // xy = pixel-to-NDC scale
 } pc;
 
-layout(location = 0) in vec2 inPosition;
+// Quantized ParticleVertex: every attribute arrives as UNORM
+layout(location = 0) in vec2 inPosition;   // inside the particle chunk; pc.mvp maps chunk to clip
 layout(location = 1) in float inLife;      // 0.0 = dead, 1.0 = just born
-layout(location = 2) in float inSize;
+layout(location = 2) in float inSize;      // fraction of MAX_SPRITE_SIZE
+layout(location = 3) in float inKind;      // ParticleKind / 255
+
+const float MAX_SPRITE_SIZE = 64.0;        // must match MAX_SPRITE_SIZE in main.cpp
 
 layout(location = 0) out float fragLife;
+layout(location = 1) out float fragKind;
+
+#ifdef INSTANCED_QUAD
+// Built with -DINSTANCED_QUAD: one instance per particle, 4 triangle-strip corners
+layout(location = 2) out vec2 fragCorner;
+const vec2 CORNERS[4] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(-1.0, 1.0), vec2(1.0, 1.0));
+#endif
 
 void main() {
-    gl_Position = pc.mvp * vec4(inPosition, 0.0, 1.0);
-    gl_PointSize = inSize * (0.5 + inLife * 0.5);
+    vec4 center = pc.mvp * vec4(inPosition, 0.0, 1.0);
+    float size = inSize * MAX_SPRITE_SIZE * (0.5 + inLife * 0.5);
+#ifdef INSTANCED_QUAD
+    vec2 corner = CORNERS[gl_VertexIndex];
+    gl_Position = center + vec4(corner * (0.5 * size) * pc.params.xy * center.w, 0.0, 0.0);
+    fragCorner = corner;
+#else
+    gl_Position = center;
+    gl_PointSize = size;
+#endif
     fragLife = inLife;
+    fragKind = inKind * 255.0;   // 0.0 = exhaust, 1.0 = regolith dust, 2.0 = debris
 }
@@ -5,12 +5,33 @@ layout(push_constant) uniform PushConstants {
     vec4 color;
 } pc;
 
+layout(set = 0, binding = 0) uniform Camera {
+    mat4 viewProj;
+} camera;
+
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec3 inColor;
 
+#ifdef INSTANCED
+// Built with -DINSTANCED: one LanderInstance per lander
+layout(location = 2) in vec2 instPosition;
+layout(location = 3) in float instAngle;   // radians, 0 = upright
+layout(location = 4) in vec4 instColor;    // RGBA8 UNORM state tint
+#endif
+
 layout(location = 0) out vec3 fragColor;
 
 void main() {
-    gl_Position = pc.mvp * vec4(inPosition, 0.0, 1.0);
+#ifdef INSTANCED
+    // Same model transform the CPU used to build: rotate by -angle, then translate
+    float c = cos(instAngle);
+    float s = sin(instAngle);
+    vec2 world = vec2(c * inPosition.x + s * inPosition.y,
+                      -s * inPosition.x + c * inPosition.y) + instPosition;
+    gl_Position = camera.viewProj * vec4(world, 0.0, 1.0);
+    fragColor = inColor * instColor.rgb * pc.color.rgb;
+#else
+    gl_Position = camera.viewProj * vec4(inPosition, 0.0, 1.0);
     fragColor = inColor * pc.color.rgb;
+#endif
 }
@@ -8,8 +8,16 @@ layout(push_constant) uniform PushConstants {
 layout(location = 0) in float fragBrightness;
 layout(location = 0) out vec4 outColor;
 
+#ifdef INSTANCED_QUAD
+layout(location = 1) in vec2 fragCorner;   // -1..1 across the quad
+#endif
+
 void main() {
+#ifdef INSTANCED_QUAD
+    vec2 coord = fragCorner;
+#else
     vec2 coord = gl_PointCoord * 2.0 - 1.0;
+#endif
     float dist = dot(coord, coord);
     if (dist > 1.0) discard;
 
@@ -3,17 +3,34 @@
 layout(push_constant) uniform PushConstants {
     mat4 mvp;
     vec4 color;
+    vec4 params;    // xy = pixel-to-NDC scale
 } pc;
 
+layout(set = 0, binding = 0) uniform Camera {
+    mat4 viewProj;
+} camera;
+
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in float inBrightness;
 layout(location = 2) in float inSize;
 
 layout(location = 0) out float fragBrightness;
 
+#ifdef INSTANCED_QUAD
+// Built with -DINSTANCED_QUAD: one instance per star, 4 triangle-strip corners
+layout(location = 1) out vec2 fragCorner;
+const vec2 CORNERS[4] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(-1.0, 1.0), vec2(1.0, 1.0));
+#endif
+
 void main() {
-    gl_Position = pc.mvp * vec4(inPosition, 0.0, 1.0);
+    vec4 center = camera.viewProj * vec4(inPosition, 0.0, 1.0);
+#ifdef INSTANCED_QUAD
+    vec2 corner = CORNERS[gl_VertexIndex];
+    gl_Position = center + vec4(corner * (0.5 * inSize) * pc.params.xy * center.w, 0.0, 0.0);
+    fragCorner = corner;
+#else
+    gl_Position = center;
     gl_PointSize = inSize;
+#endif
     fragBrightness = inBrightness;
 }
-
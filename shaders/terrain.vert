@@ -3,12 +3,18 @@
 layout(push_constant) uniform PushConstants {
     mat4 mvp;
     vec4 color;
+    vec4 params;    // xy = chunk origin, zw = chunk extent
 } pc;
 
-layout(location = 0) in vec2 inPosition;
+layout(set = 0, binding = 0) uniform Camera {
+    mat4 viewProj;
+} camera;
+
+layout(location = 0) in vec2 inPosition;   // R16G16_UNORM inside the terrain chunk
 layout(location = 0) out vec2 fragWorldPos;
 
 void main() {
-    gl_Position = pc.mvp * vec4(inPosition, 0.0, 1.0);
-    fragWorldPos = inPosition;
+    vec2 worldPos = pc.params.xy + inPosition * pc.params.zw;
+    gl_Position = camera.viewProj * vec4(worldPos, 0.0, 1.0);
+    fragWorldPos = worldPos;
 }
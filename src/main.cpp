@@ -5,18 +5,35 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "embedded_shaders.h"
+
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <exception>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <random>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
 
 // ========================================================================================
 // Constants, Structs, Helpers
@@ -24,7 +41,9 @@
 
 constexpr int WINDOW_WIDTH = 1280;
 constexpr int WINDOW_HEIGHT = 720;
-constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+constexpr int MAX_FRAMES_IN_FLIGHT = 3;   // per-slot resources; --frames-in-flight uses 1..3 of them
+constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+constexpr uint32_t LATENCY_HISTORY = 64;  // presents whose input sample time is kept for display timing
 
 constexpr float WORLD_WIDTH = 40.0f;
 constexpr float WORLD_HEIGHT = 22.5f;
@@ -34,9 +53,66 @@ constexpr float LANDING_PAD_X = 20.0f;
 constexpr float LANDING_PAD_WIDTH = 3.0f;
 constexpr int TERRAIN_SEGMENTS = 200;
 
-constexpr int MAX_PARTICLES = 500;
+// Per-frame dynamic data (particles, HUD, ...) is sub-allocated from one persistently
+// mapped ring, split into MAX_FRAMES_IN_FLIGHT regions of this size
+constexpr VkDeviceSize FRAME_RING_REGION_SIZE = 8 << 20;   // fits a full particle pool + fleet
+constexpr VkDeviceSize FRAME_RING_ALIGNMENT = 16;
+constexpr uint32_t MAX_HUD_VERTICES = 6 * 1024;   // 1024 quads
+
+constexpr float HEADLESS_DT = 1.0f / 60.0f;      // fixed sim step, so a replay renders the same frames
+constexpr double SIM_TICK_RATE = 240.0;           // lander physics ticks per second, whatever the frame rate
+constexpr float SIM_TICK = static_cast<float>(1.0 / SIM_TICK_RATE);
+constexpr uint64_t MAX_CATCHUP_TICKS = 60;        // a longer stall is skipped rather than simulated
+constexpr size_t INPUT_QUEUE_SIZE = 1024;         // power of two
+constexpr uint64_t INPUT_PUMP_INTERVAL_NS = 1'000'000;   // event polling period while the loop waits
+constexpr uint32_t CAPTURE_RING_SIZE = MAX_FRAMES_IN_FLIGHT + 2;   // staging buffers; 2 may wait on the writer
+
+// HUD font: 5x7 bitmap glyphs turned into a signed distance field atlas at startup
+constexpr int FONT_GLYPH_COLS = 5;
+constexpr int FONT_GLYPH_ROWS = 7;
+constexpr int FONT_SCALE = 4;            // atlas texels per bitmap pixel
+constexpr int FONT_CELL = 32;            // atlas texels per glyph cell, edge padding included
+constexpr int FONT_SDF_SPREAD = 4;       // texels of distance encoded on each side of an edge
+constexpr int FONT_ATLAS_COLUMNS = 8;
+
+constexpr size_t MAX_FLEET_SIZE = 100000;      // --fleet cap; one instanced draw either way
+constexpr size_t FLEET_BLOCK_SIZE = 4096;      // fleet landers per worker job
+
+constexpr size_t MAX_PARTICLES = 1 << 18;
+constexpr size_t PARTICLE_BLOCK_SIZE = 4096;   // particles per worker job
+constexpr size_t PARTICLE_SORT_BENCH_COUNT = 1 << 20;   // --bench-particle-sort pool, past MAX_PARTICLES
 constexpr float PARTICLE_LIFETIME = 0.8f;
 constexpr float PARTICLE_SPAWN_RATE = 200.0f;
+constexpr float RCS_SPAWN_RATE = 120.0f;
+constexpr size_t CRASH_DEBRIS_COUNT = 4000;
+constexpr float TOUCHDOWN_DUST_PER_SPEED = 600.0f;  // burst size per m/s of impact speed
+
+// Regolith dust kicked up when the plume reaches the ground
+constexpr float DUST_TRIGGER_ALTITUDE = 6.0f;  // lander height where the plume starts to scour
+constexpr float DUST_PER_IMPACT = 24.0f;       // ejecta per exhaust impact at touchdown
+constexpr float DUST_LIFETIME = 4.0f;
+constexpr float DUST_MIN_IMPACT_SPEED = 0.5f;
+constexpr float DUST_RESTITUTION = 0.35f;
+constexpr float DUST_FRICTION = 0.6f;
+constexpr float DUST_SETTLE_SPEED = 0.3f;
+constexpr float EXHAUST_RESTITUTION = 0.2f;
+
+// Spatial hash for particle neighbor queries, rebuilt every frame
+constexpr float PARTICLE_CELL_SIZE = 0.25f;
+constexpr uint32_t PARTICLE_HASH_BUCKETS = 1 << 12;   // power of two
+constexpr float DUST_INTERACTION_RADIUS = 0.15f;      // must not exceed PARTICLE_CELL_SIZE
+constexpr float DUST_REPULSION = 3.0f;
+constexpr int DUST_MAX_NEIGHBORS = 32;                // caps work inside dense clumps
+
+// Quantized vertex ranges: positions are 16-bit UNORM inside a chunk, sprite sizes 8-bit UNORM
+constexpr float PARTICLE_CHUNK_EXTENT = 2.0f * WORLD_WIDTH;  // camera-centered, covers the widest view
+constexpr float MAX_SPRITE_SIZE = 64.0f;                     // pixels; must match particles.vert
+const glm::vec2 TERRAIN_CHUNK_ORIGIN{0.0f, 0.0f};
+const glm::vec2 TERRAIN_CHUNK_EXTENT{WORLD_WIDTH, WORLD_HEIGHT};
+
+// Static streams (stars, terrain) are bucketed along x and culled against the view
+constexpr float CULL_BUCKET_WIDTH = 2.0f;      // world units; a zoomed-in view spans ~10 buckets
+constexpr float MAX_STAR_SIZE = 3.0f;          // pixels; pads the star cull bounds
 // 
 // Physics Sim Constants
 constexpr float LUNAR_GRAVITY = 1.62f;       // m/s² — Moon's actual surface gravity
@@ -50,6 +126,7 @@ constexpr float SAFE_LANDING_ANGLE = 0.26f;  // ~15 degrees in radians
 struct QueueFamilyIndices {
     std::optional<glm::uint32_t> graphicsFamily;
     std::optional<glm::uint32_t> presentFamily;
+    std::optional<glm::uint32_t> transferFamily;   // transfer-only family (DMA engine), if any
     bool isComplete() const { return graphicsFamily.has_value() && presentFamily.has_value(); }
 };
 
@@ -59,18 +136,36 @@ struct SwapchainSupportDetails {
     std::vector<VkPresentModeKHR> presentModes;
 };
 
+// Inputs for one graphics pipeline; everything else is shared by all pipelines
+struct PipelineDesc {
+    VkPipeline* target;
+    std::string vertShader;   // SPIR-V name, e.g. "hud.vert.spv"
+    std::string fragShader;
+    std::vector<VkVertexInputBindingDescription> bindings;
+    std::vector<VkVertexInputAttributeDescription> attributes;
+    VkPrimitiveTopology topology;
+    bool enableBlending;
+};
+
 struct Vertex2D {
     glm::vec2 pos;
     glm::vec3 color;
 };
 
+// Set 0, binding 0: per-frame camera, at the start of each frame ring region
+struct CameraUniforms {
+    glm::mat4 viewProj;
+};
+
 struct PushConstants {
     glm::mat4 mvp;
     glm::vec4 color;
+    glm::vec4 params;   // per-pipeline extras; instanced sprites use xy = pixel-to-NDC scale
 };
 
+// 16-bit UNORM position inside the terrain chunk (TERRAIN_CHUNK_ORIGIN/EXTENT)
 struct TerrainVertex {
-    glm::vec2 pos;
+    uint16_t pos[2];
 };
 
 struct StarVertex {
@@ -79,19 +174,162 @@ struct StarVertex {
     float size;
 };
 
+// Quantized to 8 bytes: uploaded for every live particle every frame
 struct ParticleVertex {
-    glm::vec2 pos;
-    float life;
-    float size;
+    uint16_t pos[2];    // UNORM inside the particle chunk (see recordCommandBuffer)
+    uint8_t life;       // UNORM life / maxLife
+    uint8_t size;       // UNORM size / MAX_SPRITE_SIZE
+    uint8_t kind;       // ParticleKind, read back as UNORM * 255 in the shader
+    uint8_t pad;
 };
 
+enum class ParticleKind : uint8_t {
+    Exhaust,
+    Dust,
+    Debris
+};
+
+// Live particles are kept packed at the front of the pool (see updateParticles)
 struct Particle {
     glm::vec2 pos;
     glm::vec2 vel;
     float life;
     float maxLife;
     float size;
+    ParticleKind kind = ParticleKind::Exhaust;
+};
+
+// Everything spawnParticles() needs to fill a batch; ranges are sampled uniformly per particle
+struct SpawnParams {
+    glm::vec2 pos{0.0f, 0.0f};
+    float radius = 0.0f;         // positional jitter around pos
+    glm::vec2 vel{0.0f, 0.0f};   // inherited velocity, e.g. the lander's
+    float direction = 0.0f;      // radians, same convention as lander.angle (0 = up)
+    float spread = 0.0f;         // +/- radians around direction
+    float speedMin = 0.0f, speedMax = 0.0f;
+    float lifeMin = 1.0f, lifeMax = 1.0f;
+    float sizeMin = 1.0f, sizeMax = 1.0f;
+    ParticleKind kind = ParticleKind::Exhaust;
+};
+
+enum class EmitterId {
+    MainEngine,
+    RcsLeft,         // fires while rotating left
+    RcsRight,        // fires while rotating right
+    CrashDebris,
+    TouchdownDust,
+    Count
+};
+
+// A particle source feeding the shared pool: continuous at `rate` while active, plus queued bursts
+struct Emitter {
+    SpawnParams params;
+    float rate = 0.0f;           // particles per second while active
     bool active = false;
+    size_t burst = 0;            // one-shot count, spawned on the next update
+    float accumulator = 0.0f;
+};
+
+// Per-job scratch for the parallel particle update
+struct ParticleBlock {
+    std::vector<float> xs;
+    std::vector<float> heights;
+    std::vector<Particle> spawned;   // dust kicked up by this block, appended after compaction
+    size_t alive = 0;
+};
+
+// How point sprites (stars, particles) are rasterized
+enum class SpriteMode {
+    Points,     // POINT_LIST + gl_PointSize, size limited by largePoints / pointSizeRange
+    Quads       // one instance per sprite, quad corners generated in the vertex shader
+};
+
+// Lander controls driven by the keyboard; each has two keys
+enum class Control {
+    Thrust,     // Up / W
+    Left,       // Left / A
+    Right,      // Right / D
+    Count
+};
+constexpr size_t CONTROL_COUNT = static_cast<size_t>(Control::Count);
+
+// A control going down or up, stamped on the simulation clock
+struct InputEvent {
+    double time;        // seconds since app start
+    Control control;
+    bool pressed;
+};
+
+// Swapchain present mode (--present)
+enum class PresentMode {
+    Auto,       // MAILBOX if available, else FIFO; IMMEDIATE for benchmarks
+    Fifo,       // vsync, queued; pair with --fps-limit so the queue stays short
+    Mailbox,    // vsync, newest frame replaces a queued one
+    Immediate   // no vsync, tears
+};
+
+// Secondary command buffers of a frame, recorded in parallel and executed in this order
+enum class DrawPass {
+    Static,      // stars, terrain, landing pad; kept until invalidateStaticPasses()
+    Particles,
+    Landers,
+    Hud,
+    Count
+};
+
+constexpr size_t DRAW_PASS_COUNT = static_cast<size_t>(DrawPass::Count);
+constexpr const char* DRAW_PASS_NAMES[DRAW_PASS_COUNT] = {
+    "recordStaticPass", "recordParticlePass", "recordLanderPass", "recordHudPass"
+};
+
+// Indirect draws of the static pass, rewritten from the camera every frame
+enum class StaticDraw {
+    Stars,
+    Terrain,
+    LandingPad,
+    Count
+};
+
+constexpr size_t STATIC_DRAW_COUNT = static_cast<size_t>(StaticDraw::Count);
+
+// Sections timed on the GPU with a begin/end timestamp pair each (--gpu-profile, --gpu-hud)
+enum class GpuSection {
+    Stars,
+    Terrain,
+    LandingPad,
+    Particles,
+    Landers,
+    Hud,
+    Count
+};
+
+constexpr size_t GPU_SECTION_COUNT = static_cast<size_t>(GpuSection::Count);
+constexpr uint32_t GPU_QUERIES_PER_FRAME = 2 * GPU_SECTION_COUNT;
+constexpr const char* GPU_SECTION_NAMES[GPU_SECTION_COUNT] = {
+    "stars", "terrain", "landing_pad", "particles", "landers", "hud"
+};
+
+// Command line configuration, parsed in main()
+struct AppOptions {
+    SpriteMode spriteMode = SpriteMode::Quads;
+    bool benchSprites = false;
+    bool benchTerrain = false;
+    bool benchParticleSort = false;
+    size_t fleetSize = 0;           // extra autopiloted landers, drawn with the player's in one call
+    std::string pipelineCacheDir;   // empty: $XDG_CACHE_HOME/luna-toy or ~/.cache/luna-toy
+    std::string shaderDir;          // empty: use the SPIR-V embedded at build time
+    std::string gpuProfilePath;     // CSV of per-section GPU ms, one row per frame; empty: off
+    bool gpuProfileHud = false;     // per-section GPU ms in the HUD
+    std::string cpuTracePath;       // Chrome trace of CPU scopes, written on F9 and at exit; empty: off
+    uint32_t headlessFrames = 0;    // render this many frames offscreen with no window, then exit; 0: windowed
+    std::string outputDir;          // captured frames as PPM files; empty: none
+    uint32_t headlessWidth = WINDOW_WIDTH;
+    uint32_t headlessHeight = WINDOW_HEIGHT;
+    std::string capturePath;        // stream every frame here ("-" = stdout); empty: off
+    bool captureRaw = false;        // packed rgb24 instead of Y4M
+    PresentMode presentMode = PresentMode::Auto;
+    uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;   // 1..MAX_FRAMES_IN_FLIGHT
+    double fpsLimit = 0.0;          // frame limiter; 0: off
 };
 
 enum class SimState {
@@ -106,23 +344,963 @@ struct Lander {
     float angle = 0.0f;       // radians, 0 = upright
     float fuel = 100.0f;
     bool thrusting = false;
+    bool rcsLeft = false;
+    bool rcsRight = false;
+    float touchdownSpeed = 0.0f;   // speed at ground contact, drives the touchdown bursts
     SimState state = SimState::Flying;
+    const char* outcome = "";      // HUD banner detail once landed or crashed
+};
+
+// Autopiloted lander for batch runs: fixed throttle and spin, no particles or HUD
+struct FleetLander {
+    glm::vec2 pos;
+    glm::vec2 vel;
+    float angle;
+    float spin;       // rad/s
+    float throttle;   // fraction of THRUST_POWER
+    float fuel;
+    SimState state;
 };
 
-struct HudRenderData {
-    std::vector<glm::vec2> vertices;
-    std::vector<std::pair<uint32_t, uint32_t>> bars;  // (firstVertex, vertexCount)
-    std::vector<glm::vec4> barColors;
+// Sub-allocation from the frame ring, valid until this frame slot comes around again
+struct FrameAllocation {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    void* data = nullptr;
+};
+
+// Frame ring data of the dynamic passes. Written on the main thread before recording,
+// so the recording jobs only read it and never touch the ring allocator.
+struct FrameDrawData {
+    FrameAllocation particles;
+    glm::mat4 particleMvp{1.0f};
+    uint32_t particleCount = 0;
+    FrameAllocation landers;
+    uint32_t landerCount = 0;
+    FrameAllocation hud;
+    uint32_t hudVertexCount = 0;
+};
+
+// Screen-space pixel position, font atlas UV and RGBA8 color, so bars and text are one draw
+struct HudVertex {
+    glm::vec2 pos;
+    uint16_t uv[2];
+    uint8_t color[4];
+};
+
+// Per-instance input of the instanced lander pipeline; shader.vert builds the model transform
+struct LanderInstance {
+    glm::vec2 pos;
+    float angle;
+    uint8_t color[4];   // RGBA8 UNORM state tint
+};
+
+// Reads a SPIR-V file into word storage, so the code pointer is uint32_t-aligned
+std::vector<uint32_t> readSpirv(const std::string& filename) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("Failed to open file: " + filename);
+    size_t fileSize = static_cast<size_t>(file.tellg());
+    if (fileSize == 0 || fileSize % sizeof(uint32_t) != 0)
+        throw std::runtime_error("Not a SPIR-V file: " + filename);
+    std::vector<uint32_t> buffer(fileSize / sizeof(uint32_t));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(buffer.data()), fileSize);
+    return buffer;
+};
+
+inline uint16_t quantizeUnorm16(float v) {
+    return static_cast<uint16_t>(std::clamp(v, 0.0f, 1.0f) * 65535.0f + 0.5f);
+}
+
+inline uint8_t quantizeUnorm8(float v) {
+    return static_cast<uint8_t>(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+inline TerrainVertex quantizeTerrainVertex(glm::vec2 pt) {
+    glm::vec2 n = (pt - TERRAIN_CHUNK_ORIGIN) / TERRAIN_CHUNK_EXTENT;
+    return TerrainVertex{{quantizeUnorm16(n.x), quantizeUnorm16(n.y)}};
+}
+
+// Static stream sorted by x and split into fixed-width buckets. Buckets overlapping a view
+// are adjacent, so culling yields one element range and one draw per stream.
+struct CullBuckets {
+    float origin = 0.0f;
+    float width = WORLD_WIDTH;
+    std::vector<uint32_t> start{0, 0};   // bucket count + 1 prefix offsets into the stream
+
+    // getX(i) must be non-decreasing in i; elements outside the buckets clamp to the edges
+    template <typename GetX>
+    static CullBuckets build(size_t count, float origin, float extent, float width, GetX&& getX) {
+        CullBuckets b;
+        b.origin = origin;
+        b.width = width;
+        uint32_t bucketCount = std::max(1u, static_cast<uint32_t>(std::ceil(extent / width)));
+        b.start.assign(bucketCount + 1, 0);
+        for (size_t i = 0; i < count; i++)
+            b.start[b.bucketOf(getX(i)) + 1]++;
+        for (uint32_t k = 0; k < bucketCount; k++)
+            b.start[k + 1] += b.start[k];
+        return b;
+    }
+
+    // One bucket holding every element: never culled
+    static CullBuckets whole(uint32_t count) {
+        CullBuckets b;
+        b.start = {0, count};
+        return b;
+    }
+
+    uint32_t bucketOf(float x) const {
+        int32_t k = static_cast<int32_t>(std::floor((x - origin) / width));
+        return static_cast<uint32_t>(std::clamp(k, 0, static_cast<int32_t>(start.size()) - 2));
+    }
+
+    // Elements [first, end) of every bucket overlapping [minX, maxX]
+    void visibleRange(float minX, float maxX, uint32_t& first, uint32_t& end) const {
+        first = start[bucketOf(minX)];
+        end = start[bucketOf(maxX) + 1];
+    }
 };
 
-std::vector<char> readFile(const std::string& filename) {
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-    if (!file.is_open()) throw std::runtime_error("Failed to open file: " + filename);
-    size_t fileSize = static_cast<size_t>(file.tellg());
-    std::vector<char> buffer(fileSize);
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    return buffer;
+// Uniform grid cell -> hash bucket. Distinct cells may share a bucket; neighbor
+// queries check distance, so a collision only costs a few extra comparisons.
+inline uint32_t particleCellHash(int32_t cx, int32_t cy) {
+    return (static_cast<uint32_t>(cx) * 73856093u ^ static_cast<uint32_t>(cy) * 19349663u)
+        & (PARTICLE_HASH_BUCKETS - 1);
+}
+
+inline int32_t particleCell(float v) {
+    return static_cast<int32_t>(std::floor(v * (1.0f / PARTICLE_CELL_SIZE)));
+}
+
+// Small xorshift generator; cheap enough to seed one per worker job
+struct FastRng {
+    uint32_t state;
+    explicit FastRng(uint32_t seed) : state(seed ? seed : 0x9E3779B9u) {}
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    float uniform() { return (next() >> 8) * (1.0f / 16777216.0f); }
+    float uniform(float lo, float hi) { return lo + (hi - lo) * uniform(); }
+};
+
+
+// ========================================================================================
+// HUD Font
+// ========================================================================================
+
+// Glyph order in the atlas; cell 0 is solid and backs untextured HUD quads
+constexpr char FONT_CHARS[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.:-/%+";
+constexpr int FONT_GLYPH_COUNT = sizeof(FONT_CHARS);   // + solid cell, - terminator
+constexpr int FONT_ATLAS_WIDTH = FONT_ATLAS_COLUMNS * FONT_CELL;
+constexpr int FONT_ATLAS_HEIGHT = (FONT_GLYPH_COUNT + FONT_ATLAS_COLUMNS - 1) / FONT_ATLAS_COLUMNS * FONT_CELL;
+
+// One byte per row, low 5 bits, MSB = leftmost pixel
+const uint8_t FONT_BITMAPS[][FONT_GLYPH_ROWS] = {
+    {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E},  // 0
+    {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E},  // 1
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F},  // 2
+    {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E},  // 3
+    {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02},  // 4
+    {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E},  // 5
+    {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E},  // 6
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08},  // 7
+    {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E},  // 8
+    {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C},  // 9
+    {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11},  // A
+    {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E},  // B
+    {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E},  // C
+    {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C},  // D
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F},  // E
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10},  // F
+    {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F},  // G
+    {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11},  // H
+    {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E},  // I
+    {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C},  // J
+    {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11},  // K
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F},  // L
+    {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11},  // M
+    {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11},  // N
+    {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E},  // O
+    {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10},  // P
+    {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D},  // Q
+    {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11},  // R
+    {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E},  // S
+    {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04},  // T
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E},  // U
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04},  // V
+    {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A},  // W
+    {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11},  // X
+    {0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04},  // Y
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F},  // Z
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C},  // .
+    {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00},  // :
+    {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00},  // -
+    {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00},  // /
+    {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03},  // %
+    {0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00},  // +
+};
+static_assert(sizeof(FONT_BITMAPS) / sizeof(FONT_BITMAPS[0]) == sizeof(FONT_CHARS) - 1,
+              "one bitmap per font character");
+
+// Atlas cell of a character, or -1 if the font lacks it (lowercase maps to uppercase)
+inline int fontGlyphCell(char c) {
+    static const std::array<int8_t, 128> table = [] {
+        std::array<int8_t, 128> t;
+        t.fill(-1);
+        for (int i = 0; FONT_CHARS[i]; i++) {
+            t[static_cast<unsigned char>(FONT_CHARS[i])] = static_cast<int8_t>(i + 1);
+            if (FONT_CHARS[i] >= 'A' && FONT_CHARS[i] <= 'Z')
+                t[static_cast<unsigned char>(FONT_CHARS[i] - 'A' + 'a')] = static_cast<int8_t>(i + 1);
+        }
+        return t;
+    }();
+    unsigned char u = static_cast<unsigned char>(c);
+    return u < 128 ? table[u] : -1;
+}
+
+// R8 signed distance field, 0.5 on glyph edges. Brute force over a small window is
+// plenty for a few dozen 32x32 cells and keeps the font free of external tooling.
+inline std::vector<uint8_t> buildFontAtlas() {
+    std::vector<uint8_t> atlas(FONT_ATLAS_WIDTH * FONT_ATLAS_HEIGHT, 0);
+    constexpr int padX = (FONT_CELL - FONT_GLYPH_COLS * FONT_SCALE) / 2;
+    constexpr int padY = (FONT_CELL - FONT_GLYPH_ROWS * FONT_SCALE) / 2;
+    constexpr int radius = FONT_SDF_SPREAD + 1;
+
+    for (int cell = 0; cell < FONT_GLYPH_COUNT; cell++) {
+        int cellX = cell % FONT_ATLAS_COLUMNS * FONT_CELL;
+        int cellY = cell / FONT_ATLAS_COLUMNS * FONT_CELL;
+        auto inside = [&](int tx, int ty) {
+            if (cell == 0) return true;
+            int px = (tx - padX) / FONT_SCALE, py = (ty - padY) / FONT_SCALE;
+            if (tx < padX || ty < padY || px >= FONT_GLYPH_COLS || py >= FONT_GLYPH_ROWS) return false;
+            return ((FONT_BITMAPS[cell - 1][py] >> (FONT_GLYPH_COLS - 1 - px)) & 1) != 0;
+        };
+
+        for (int ty = 0; ty < FONT_CELL; ty++) {
+            for (int tx = 0; tx < FONT_CELL; tx++) {
+                bool in = inside(tx, ty);
+                float nearest = static_cast<float>(radius);
+                for (int dy = -radius; dy <= radius; dy++) {
+                    for (int dx = -radius; dx <= radius; dx++) {
+                        int sx = tx + dx, sy = ty + dy;
+                        // Off-cell texels count as outside, except around the solid cell
+                        bool offCell = sx < 0 || sy < 0 || sx >= FONT_CELL || sy >= FONT_CELL;
+                        bool other = offCell ? cell != 0 && in : inside(sx, sy) != in;
+                        if (other) nearest = std::min(nearest, std::sqrt(float(dx * dx + dy * dy)));
+                    }
+                }
+                float dist = (nearest - 0.5f) * (in ? 1.0f : -1.0f);
+                atlas[(cellY + ty) * FONT_ATLAS_WIDTH + cellX + tx] =
+                    quantizeUnorm8(0.5f + dist / (2.0f * FONT_SDF_SPREAD));
+            }
+        }
+    }
+    return atlas;
+}
+
+// Appends HUD geometry straight into mapped (write-combined) memory, so it only
+// ever writes; quads past capacity are dropped
+struct HudBatch {
+    HudVertex* vertices = nullptr;
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+
+    // Solid quad: samples the middle of the all-inside atlas cell
+    void addQuad(float x, float y, float w, float h, glm::vec4 color) {
+        glm::vec2 solid(0.5f * FONT_CELL / FONT_ATLAS_WIDTH, 0.5f * FONT_CELL / FONT_ATLAS_HEIGHT);
+        addQuad(x, y, w, h, solid, solid, color);
+    }
+
+    void addQuad(float x, float y, float w, float h, glm::vec2 uv0, glm::vec2 uv1, glm::vec4 color) {
+        if (count + 6 > capacity) return;
+        HudVertex v{};
+        for (int c = 0; c < 4; c++) v.color[c] = quantizeUnorm8(color[c]);
+        const glm::vec4 corners[6] = {   // xy = position, zw = uv
+            {x, y, uv0.x, uv0.y}, {x + w, y, uv1.x, uv0.y}, {x + w, y + h, uv1.x, uv1.y},
+            {x, y, uv0.x, uv0.y}, {x + w, y + h, uv1.x, uv1.y}, {x, y + h, uv0.x, uv1.y}
+        };
+        for (const auto& corner : corners) {
+            v.pos = {corner.x, corner.y};
+            v.uv[0] = quantizeUnorm16(corner.z);
+            v.uv[1] = quantizeUnorm16(corner.w);
+            vertices[count++] = v;
+        }
+    }
+
+    // Pixels per glyph advance at a given cap height
+    static float textAdvance(float size) {
+        return size * (FONT_GLYPH_COLS + 1) / FONT_GLYPH_ROWS;
+    }
+
+    // (x, y) is the top-left of the first glyph's cap box; size is cap height in pixels
+    void addText(float x, float y, float size, const char* text, glm::vec4 color) {
+        float k = size / (FONT_GLYPH_ROWS * FONT_SCALE);   // pixels per atlas texel
+        float cellSize = FONT_CELL * k;
+        float padX = (FONT_CELL - FONT_GLYPH_COLS * FONT_SCALE) / 2 * k;
+        float padY = (FONT_CELL - FONT_GLYPH_ROWS * FONT_SCALE) / 2 * k;
+        for (const char* c = text; *c; c++, x += textAdvance(size)) {
+            int cell = fontGlyphCell(*c);
+            if (cell < 0) continue;   // space and unknown characters just advance
+            glm::vec2 uv0(float(cell % FONT_ATLAS_COLUMNS * FONT_CELL) / FONT_ATLAS_WIDTH,
+                          float(cell / FONT_ATLAS_COLUMNS * FONT_CELL) / FONT_ATLAS_HEIGHT);
+            glm::vec2 uv1 = uv0 + glm::vec2(float(FONT_CELL) / FONT_ATLAS_WIDTH, float(FONT_CELL) / FONT_ATLAS_HEIGHT);
+            addQuad(x - padX, y - padY, cellSize, cellSize, uv0, uv1, color);
+        }
+    }
+};
+
+
+// ========================================================================================
+// CPU Profiler
+// ========================================================================================
+
+// Compiled in with -DLUNA_CPU_PROFILER (CMake option of the same name). Without it,
+// PROFILE_SCOPE expands to nothing.
+#ifdef LUNA_CPU_PROFILER
+
+constexpr size_t PROFILE_EVENTS_PER_THREAD = 1 << 16;   // per-thread ring, oldest overwritten
+
+struct ProfileEvent {
+    const char* name;   // string literal
+    uint64_t startNs;
+    uint64_t durationNs;
+};
+
+// Scoped timers write into a ring owned by the recording thread, so recording takes no
+// lock; the registry mutex is taken once per thread, on its first event. Rings outlive
+// their threads. writeChromeTrace() reads every ring and should run while workers are idle.
+class CpuProfiler {
+
+public:
+    static CpuProfiler& instance() {
+        static CpuProfiler profiler;
+        return profiler;
+    }
+
+    void setEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    static uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    void record(const char* name, uint64_t startNs, uint64_t endNs) {
+        ThreadRing& ring = threadRing();
+        uint64_t head = ring.head.load(std::memory_order_relaxed);
+        ring.events[head % PROFILE_EVENTS_PER_THREAD] = {name, startNs, endNs - startNs};
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    // Chrome trace_event JSON (chrome://tracing, Perfetto): one complete event per scope
+    bool writeChromeTrace(const std::string& path) {
+        std::ofstream file(path, std::ios::trunc);
+        if (!file) return false;
+
+        std::lock_guard<std::mutex> lock(registryMutex);
+        file << "{\"traceEvents\":[\n";
+        bool first = true;
+        char line[256];
+        for (const auto& ring : rings) {
+            std::snprintf(line, sizeof(line),
+                "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", ring->tid, ring->tid == 1 ? "main" : "worker");
+            file << line;
+            first = false;
+
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            uint64_t count = std::min<uint64_t>(head, PROFILE_EVENTS_PER_THREAD);
+            for (uint64_t i = head - count; i < head; i++) {
+                const ProfileEvent& e = ring->events[i % PROFILE_EVENTS_PER_THREAD];
+                std::snprintf(line, sizeof(line),
+                    ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    e.name, ring->tid, (e.startNs - epochNs) * 1e-3, e.durationNs * 1e-3);
+                file << line;
+            }
+        }
+        file << "\n]}\n";
+        return static_cast<bool>(file);
+    }
+
+private:
+    struct ThreadRing {
+        uint32_t tid = 0;   // 1 = first thread to record, normally the main thread
+        std::atomic<uint64_t> head{0};
+        std::vector<ProfileEvent> events = std::vector<ProfileEvent>(PROFILE_EVENTS_PER_THREAD);
+    };
+
+    std::atomic<bool> enabled{false};
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<ThreadRing>> rings;
+    uint64_t epochNs = now();   // trace timestamps start near zero
+
+    ThreadRing& threadRing() {
+        thread_local ThreadRing* ring = nullptr;
+        if (!ring) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            rings.push_back(std::make_unique<ThreadRing>());
+            ring = rings.back().get();
+            ring->tid = static_cast<uint32_t>(rings.size());
+        }
+        return *ring;
+    }
+};
+
+// Times the enclosing scope; costs one relaxed load when the profiler is disabled
+class ProfileScope {
+
+public:
+    explicit ProfileScope(const char* name)
+        : name(name), startNs(CpuProfiler::instance().isEnabled() ? CpuProfiler::now() : 0) {}
+
+    ~ProfileScope() {
+        if (startNs) CpuProfiler::instance().record(name, startNs, CpuProfiler::now());
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name;
+    uint64_t startNs;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+
+#endif
+
+
+// ========================================================================================
+// Worker Pool
+// ========================================================================================
+
+// Fixed set of threads for data-parallel sim work. The calling thread joins in,
+// so parallelFor() runs inline when the machine has a single core. Several threads
+// may call parallelFor(); their jobs run one after another.
+class WorkerPool {
+
+public:
+    WorkerPool() {
+        unsigned count = std::max(1u, std::thread::hardware_concurrency()) - 1;
+        for (unsigned i = 0; i < count; i++)
+            threads.emplace_back([this] { workerLoop(); });
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : threads) t.join();
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t size() const { return threads.size() + 1; }
+
+    // Calls fn(begin, end) for each blockSize slice of [0, count) and waits for all of them
+    template <typename Fn>
+    void parallelFor(size_t count, size_t blockSize, Fn&& fn) {
+        if (count == 0) return;
+        size_t blocks = (count + blockSize - 1) / blockSize;
+        auto body = [&](size_t block) {
+            size_t begin = block * blockSize;
+            fn(begin, std::min(count, begin + blockSize));
+        };
+        if (blocks == 1 || threads.empty()) {
+            for (size_t b = 0; b < blocks; b++) body(b);
+            return;
+        }
+
+        std::lock_guard<std::mutex> caller(callerMutex);
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return busy == 0; });
+        jobContext = &body;
+        jobInvoke = [](void* ctx, size_t block) { (*static_cast<decltype(body)*>(ctx))(block); };
+        jobBlocks = blocks;
+        nextBlock.store(0);
+        generation++;
+        lock.unlock();
+        wake.notify_all();
+
+        runBlocks();
+
+        lock.lock();
+        done.wait(lock, [&] { return busy == 0; });
+        jobContext = nullptr;
+    }
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex callerMutex;     // one job in flight at a time
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool stopping = false;
+    uint64_t generation = 0;
+    int busy = 0;               // workers currently inside runBlocks()
+
+    void* jobContext = nullptr;
+    void (*jobInvoke)(void*, size_t) = nullptr;
+    size_t jobBlocks = 0;
+    std::atomic<size_t> nextBlock{0};
+
+    void runBlocks() {
+        for (;;) {
+            size_t block = nextBlock.fetch_add(1);
+            if (block >= jobBlocks) return;
+            jobInvoke(jobContext, block);
+        }
+    }
+
+    void workerLoop() {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            busy++;
+            lock.unlock();
+            runBlocks();
+            lock.lock();
+            if (--busy == 0) done.notify_all();
+        }
+    }
+};
+
+
+// ========================================================================================
+// SPSC Queue
+// ========================================================================================
+
+// Lock-free ring for one producer and one consumer thread. Only the producer writes
+// tail and only the consumer writes head; release/acquire on them hands each slot over.
+// A full ring rejects push() instead of blocking the producer.
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert((N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+    bool push(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N) return false;
+        items[t & (N - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Oldest item, or nullptr when empty; it stays queued until pop()
+    const T* peek() const {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return nullptr;
+        return &items[h & (N - 1)];
+    }
+
+    void pop() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    std::array<T, N> items{};
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
+
+
+// ========================================================================================
+// Frame Writer
+// ========================================================================================
+
+enum class CaptureFormat {
+    None,
+    Y4m,    // YUV4MPEG2, 4:2:0 BT.601; e.g. ffmpeg -i -
+    Raw     // packed rgb24, no header; e.g. ffmpeg -f rawvideo -pixel_format rgb24 -video_size WxH -i -
+};
+
+// Encodes captured frames on its own thread, so a slow disk or encoder pipe never blocks
+// rendering. Frames are read straight from mapped staging buffers: acquire() hands a
+// buffer to the renderer, push() queues it once the GPU copy has finished, and the
+// writer frees it after writing. Writes go to a stream, to one PPM per frame, or both.
+class FrameWriter {
+
+public:
+    struct Frame {
+        const uint8_t* pixels;   // width * height * 4 bytes, RGBA or BGRA
+        uint32_t buffer;
+        uint64_t number;
+    };
+
+    ~FrameWriter() { finish(); }
+
+    // fps is the playback rate written to the Y4M header, as fpsNum / fpsDen
+    void start(uint32_t w, uint32_t h, bool isBgra, uint32_t bufferCount,
+               std::FILE* out, CaptureFormat fmt, std::string dir, uint32_t fpsNum, uint32_t fpsDen) {
+        width = w;
+        height = h;
+        bgra = isBgra;
+        busy.assign(bufferCount, false);
+        stream = out;
+        format = fmt;
+        ppmDir = std::move(dir);
+        if (stream && format == CaptureFormat::Y4m)
+            std::fprintf(stream, "YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C420jpeg\n", width, height, fpsNum, fpsDen);
+        thread = std::thread([this] { run(); });
+    }
+
+    // Blocks while the writer still owns the buffer; returns the milliseconds spent waiting
+    double acquire(uint32_t buffer) {
+        auto start = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return !busy[buffer]; });
+        busy[buffer] = true;
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void push(const Frame& frame) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(frame);
+        }
+        changed.notify_all();
+    }
+
+    // Writes everything queued, then closes the stream; returns false after a write error
+    bool finish() {
+        if (!thread.joinable()) return !failed;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        thread.join();
+        if (stream) {
+            if (std::fflush(stream) != 0) failed = true;
+            if (stream != stdout) std::fclose(stream);
+            stream = nullptr;
+        }
+        return !failed;
+    }
+
+private:
+    uint32_t width = 0;
+    uint32_t height = 0;
+    bool bgra = false;
+    std::FILE* stream = nullptr;
+    CaptureFormat format = CaptureFormat::None;
+    std::string ppmDir;
+    std::vector<uint8_t> scratch;   // converted frame, writer thread only
+    bool failed = false;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable changed;   // queue grew, a buffer was freed, or stopping
+    std::deque<Frame> queue;
+    std::vector<bool> busy;
+    bool stopping = false;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            changed.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (queue.empty()) return;   // stopping, and everything is written
+            Frame frame = queue.front();
+            queue.pop_front();
+            lock.unlock();
+            write(frame);
+            lock.lock();
+            busy[frame.buffer] = false;
+            changed.notify_all();
+        }
+    }
+
+    void write(const Frame& frame) {
+        if (stream && format == CaptureFormat::Y4m) {
+            toYuv420(frame.pixels);
+            std::fputs("FRAME\n", stream);
+            if (std::fwrite(scratch.data(), 1, scratch.size(), stream) != scratch.size()) failed = true;
+        } else if (stream && format == CaptureFormat::Raw) {
+            toRgb(frame.pixels);
+            if (std::fwrite(scratch.data(), 1, scratch.size(), stream) != scratch.size()) failed = true;
+        }
+
+        if (!ppmDir.empty()) {
+            toRgb(frame.pixels);
+            char name[32];
+            std::snprintf(name, sizeof(name), "frame_%05llu.ppm", static_cast<unsigned long long>(frame.number));
+            std::ofstream file(std::filesystem::path(ppmDir) / name, std::ios::binary | std::ios::trunc);
+            file << "P6\n" << width << ' ' << height << "\n255\n";
+            file.write(reinterpret_cast<const char*>(scratch.data()), static_cast<std::streamsize>(scratch.size()));
+            if (!file) failed = true;
+        }
+    }
+
+    void toRgb(const uint8_t* in) {
+        size_t pixels = size_t(width) * height;
+        scratch.resize(pixels * 3);
+        int r = bgra ? 2 : 0, b = bgra ? 0 : 2;
+        for (size_t i = 0; i < pixels; i++) {
+            scratch[3 * i + 0] = in[4 * i + r];
+            scratch[3 * i + 1] = in[4 * i + 1];
+            scratch[3 * i + 2] = in[4 * i + b];
+        }
+    }
+
+    // BT.601 studio range; chroma is the average of each 2x2 block
+    void toYuv420(const uint8_t* in) {
+        size_t cw = (width + 1) / 2, ch = (height + 1) / 2;
+        scratch.resize(size_t(width) * height + 2 * cw * ch);
+        uint8_t* yPlane = scratch.data();
+        uint8_t* uPlane = yPlane + size_t(width) * height;
+        uint8_t* vPlane = uPlane + cw * ch;
+        int r = bgra ? 2 : 0, b = bgra ? 0 : 2;
+
+        for (uint32_t y = 0; y < height; y++) {
+            const uint8_t* row = in + size_t(y) * width * 4;
+            for (uint32_t x = 0; x < width; x++) {
+                const uint8_t* p = row + 4 * x;
+                yPlane[size_t(y) * width + x] =
+                    static_cast<uint8_t>(((66 * p[r] + 129 * p[1] + 25 * p[b] + 128) >> 8) + 16);
+            }
+        }
+        for (size_t cy = 0; cy < ch; cy++) {
+            for (size_t cx = 0; cx < cw; cx++) {
+                int sr = 0, sg = 0, sb = 0, n = 0;
+                for (size_t y = 2 * cy; y < std::min<size_t>(2 * cy + 2, height); y++) {
+                    for (size_t x = 2 * cx; x < std::min<size_t>(2 * cx + 2, width); x++) {
+                        const uint8_t* p = in + (y * width + x) * 4;
+                        sr += p[r];
+                        sg += p[1];
+                        sb += p[b];
+                        n++;
+                    }
+                }
+                sr /= n;
+                sg /= n;
+                sb /= n;
+                uPlane[cy * cw + cx] = static_cast<uint8_t>(((-38 * sr - 74 * sg + 112 * sb + 128) >> 8) + 128);
+                vPlane[cy * cw + cx] = static_cast<uint8_t>(((112 * sr - 94 * sg - 18 * sb + 128) >> 8) + 128);
+            }
+        }
+    }
+};
+
+
+// ========================================================================================
+// Device Memory Allocator
+// ========================================================================================
+
+constexpr VkDeviceSize MEMORY_BLOCK_SIZE = 64ull << 20;   // capped at 1/8 of small heaps
+
+// Sub-range of an allocator block. Host-visible blocks stay mapped for their whole
+// lifetime, so mapped points straight at this allocation's bytes.
+struct MemoryAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;
+    uint32_t block = UINT32_MAX;
+};
+
+// Reserves large VkDeviceMemory blocks per memory type and hands out first-fit
+// sub-allocations from each block's sorted free list; frees coalesce with their
+// neighbours. Linear (buffer) and optimal (image) resources never share a block,
+// which keeps them bufferImageGranularity apart without padding every allocation.
+class MemoryAllocator {
+
+public:
+    void init(VkDevice dev, VkPhysicalDevice physical) {
+        device = dev;
+        vkGetPhysicalDeviceMemoryProperties(physical, &memProps);
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(physical, &props);
+        maxAllocations = props.limits.maxMemoryAllocationCount;
+    }
+
+    MemoryAllocation allocate(const VkMemoryRequirements& reqs, uint32_t memoryType, bool linear = true) {
+        VkDeviceSize offset;
+        for (uint32_t i = 0; i < blocks.size(); i++) {
+            Block& b = blocks[i];
+            if (b.memory == VK_NULL_HANDLE || b.memoryType != memoryType || b.linear != linear)
+                continue;
+            if (b.carve(reqs.size, reqs.alignment, offset))
+                return makeAllocation(i, offset, reqs.size);
+        }
+        uint32_t i = createBlock(memoryType, linear, std::max(blockSizeFor(memoryType), reqs.size));
+        blocks[i].carve(reqs.size, reqs.alignment, offset);   // offset 0 of a fresh block always fits
+        return makeAllocation(i, offset, reqs.size);
+    }
+
+    void free(MemoryAllocation& alloc) {
+        if (alloc.block == UINT32_MAX) return;
+        Block& b = blocks[alloc.block];
+        b.release(alloc.offset, alloc.size);
+        // Oversized blocks exist for a single resource; return them as soon as they empty
+        if (b.allocations == 0 && b.size > blockSizeFor(b.memoryType))
+            destroyBlock(b);
+        alloc = MemoryAllocation{};
+    }
+
+    void destroy() {
+        for (auto& b : blocks) destroyBlock(b);
+        blocks.clear();
+    }
+
+    // Per memory type: reserved vs used bytes, free ranges, and external fragmentation
+    // (1 - largest free range / total free), i.e. how much free space a single large
+    // request could not use
+    void printStats() const {
+        std::printf("Device memory: %u of %u allocations\n", allocationCount, maxAllocations);
+        for (uint32_t type = 0; type < memProps.memoryTypeCount; type++) {
+            uint32_t blockCount = 0, allocations = 0;
+            size_t freeRanges = 0;
+            VkDeviceSize reserved = 0, used = 0, largestFree = 0;
+            for (const auto& b : blocks) {
+                if (b.memory == VK_NULL_HANDLE || b.memoryType != type) continue;
+                blockCount++;
+                allocations += b.allocations;
+                reserved += b.size;
+                used += b.used;
+                freeRanges += b.freeList.size();
+                for (const auto& r : b.freeList) largestFree = std::max(largestFree, r.size);
+            }
+            if (blockCount == 0) continue;
+            VkDeviceSize totalFree = reserved - used;
+            double fragmentation = totalFree ? 1.0 - double(largestFree) / double(totalFree) : 0.0;
+            std::printf("  type %2u: %u blocks, %7.2f MiB reserved, %7.2f MiB used in %u allocations, "
+                        "%zu free ranges, fragmentation %.0f%%\n",
+                type, blockCount, reserved / 1048576.0, used / 1048576.0, allocations,
+                freeRanges, fragmentation * 100.0);
+        }
+    }
+
+private:
+    struct Range {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        uint32_t memoryType = 0;
+        bool linear = true;
+        VkDeviceSize size = 0;
+        VkDeviceSize used = 0;
+        uint32_t allocations = 0;
+        uint8_t* mapped = nullptr;
+        std::vector<Range> freeList;   // sorted by offset, never adjacent
+
+        bool carve(VkDeviceSize bytes, VkDeviceSize alignment, VkDeviceSize& out) {
+            for (size_t i = 0; i < freeList.size(); i++) {
+                Range r = freeList[i];
+                VkDeviceSize offset = (r.offset + alignment - 1) / alignment * alignment;
+                if (offset + bytes > r.offset + r.size) continue;
+
+                // Alignment padding in front stays free, as does the tail
+                Range head{r.offset, offset - r.offset};
+                Range tail{offset + bytes, r.offset + r.size - (offset + bytes)};
+                freeList.erase(freeList.begin() + i);
+                if (tail.size > 0) freeList.insert(freeList.begin() + i, tail);
+                if (head.size > 0) freeList.insert(freeList.begin() + i, head);
+
+                used += bytes;
+                allocations++;
+                out = offset;
+                return true;
+            }
+            return false;
+        }
+
+        void release(VkDeviceSize offset, VkDeviceSize bytes) {
+            auto it = std::lower_bound(freeList.begin(), freeList.end(), offset,
+                [](const Range& r, VkDeviceSize o) { return r.offset < o; });
+            it = freeList.insert(it, {offset, bytes});
+            auto next = it + 1;
+            if (next != freeList.end() && it->offset + it->size == next->offset) {
+                it->size += next->size;
+                freeList.erase(next);
+            }
+            if (it != freeList.begin()) {
+                auto prev = it - 1;
+                if (prev->offset + prev->size == it->offset) {
+                    prev->size += it->size;
+                    freeList.erase(it);
+                }
+            }
+            used -= bytes;
+            allocations--;
+        }
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memProps{};
+    uint32_t maxAllocations = 0;
+    uint32_t allocationCount = 0;   // live vkAllocateMemory calls
+    std::vector<Block> blocks;      // indices stay stable; destroyed blocks are reused
+
+    VkDeviceSize blockSizeFor(uint32_t memoryType) const {
+        VkDeviceSize heapSize = memProps.memoryHeaps[memProps.memoryTypes[memoryType].heapIndex].size;
+        return std::min(MEMORY_BLOCK_SIZE, heapSize / 8);
+    }
+
+    uint32_t createBlock(uint32_t memoryType, bool linear, VkDeviceSize size) {
+        if (allocationCount >= maxAllocations)
+            throw std::runtime_error("maxMemoryAllocationCount reached");
+
+        Block b;
+        b.memoryType = memoryType;
+        b.linear = linear;
+        b.size = size;
+        b.freeList.push_back({0, size});
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryType;
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &b.memory) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate device memory block");
+        allocationCount++;
+
+        if (memProps.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            void* mapped;
+            vkMapMemory(device, b.memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+            b.mapped = static_cast<uint8_t*>(mapped);
+        }
+
+        for (uint32_t i = 0; i < blocks.size(); i++) {
+            if (blocks[i].memory == VK_NULL_HANDLE) {
+                blocks[i] = std::move(b);
+                return i;
+            }
+        }
+        blocks.push_back(std::move(b));
+        return static_cast<uint32_t>(blocks.size() - 1);
+    }
+
+    void destroyBlock(Block& b) {
+        if (b.memory == VK_NULL_HANDLE) return;
+        vkFreeMemory(device, b.memory, nullptr);   // implicitly unmaps
+        allocationCount--;
+        b = Block{};
+    }
+
+    MemoryAllocation makeAllocation(uint32_t block, VkDeviceSize offset, VkDeviceSize size) const {
+        const Block& b = blocks[block];
+        return {b.memory, offset, size, b.mapped ? b.mapped + offset : nullptr, block};
+    }
 };
 
 
@@ -133,15 +1311,43 @@ std::vector<char> readFile(const std::string& filename) {
 class LunaApp {
 
 public:
+    explicit LunaApp(const AppOptions& opts)
+        : options(opts), startTime(std::chrono::steady_clock::now()) {}
+
+    ~LunaApp() {
+        if (pipelineThread.joinable()) pipelineThread.join();
+    }
+
     void run() {
-        initWindow();
+#ifdef LUNA_CPU_PROFILER
+        CpuProfiler::instance().setEnabled(!options.cpuTracePath.empty());
+#endif
+        if (options.benchParticleSort) {   // CPU only: no window or device
+            runParticleSortBenchmark();
+            writeCpuTrace();
+            return;
+        }
+        if (options.capturePath == "-") redirectStdout();
+        if (!headless()) initWindow();
         initVulkan();
         initSim();
-        mainLoop();
+        finishPipelineBuild();
+        if (options.benchSprites)
+            runSpriteBenchmark();
+        else if (options.benchTerrain)
+            runTerrainBenchmark();
+        else if (headless())
+            runHeadless();
+        else
+            mainLoop();
+        finishCapture();
+        writeCpuTrace();
         cleanup();
     }
 
 private:
+    AppOptions options;
+    std::chrono::steady_clock::time_point startTime;   // for time-to-first-frame
     GLFWwindow* window = nullptr;
     
     // Vulkan Core
@@ -151,6 +1357,8 @@ private:
     VkDevice device = VK_NULL_HANDLE;
     VkQueue graphicsQueue = VK_NULL_HANDLE;
     VkQueue presentQueue = VK_NULL_HANDLE;
+    VkQueue transferQueue = VK_NULL_HANDLE;     // == graphicsQueue without a transfer-only family
+    QueueFamilyIndices queueFamilies;
     
     // Vulkan Swapchain
     VkSwapchainKHR swapchain = VK_NULL_HANDLE;
@@ -159,26 +1367,115 @@ private:
     VkExtent2D swapchainExtent;
     std::vector<VkImageView> swapchainImageViews;
 
+    // Headless: offscreen images stand in for the swapchain, one per frame in flight
+    std::vector<MemoryAllocation> offscreenImageMemory;
+
+    // Capture (--capture, and every headless frame): after the render pass each frame is
+    // copied into the next buffer of a host-visible ring. The CPU maps it only after the
+    // frame has passed on the timeline, then captureWriter encodes it on its own thread.
+    struct SlotCapture {
+        int32_t buffer = -1;   // ring index copied into by the slot's last frame, -1 = none
+        uint64_t frame = 0;
+    };
+    std::array<VkBuffer, CAPTURE_RING_SIZE> captureBuffers{};
+    std::array<MemoryAllocation, CAPTURE_RING_SIZE> captureMemory{};
+    std::FILE* captureStdout = nullptr;   // the real stdout for --capture -, once logging moved off it
+    bool captureCoherent = true;   // else collectCapture() invalidates before reading
+    std::array<SlotCapture, MAX_FRAMES_IN_FLIGHT> slotCaptures{};
+    uint32_t nextCaptureBuffer = 0;
+    VkExtent2D captureExtent{};    // fixed for the stream; frames of another size are skipped
+    FrameWriter captureWriter;
+    uint64_t capturedFrames = 0;
+    uint64_t skippedCaptureFrames = 0;
+    double captureStallMs = 0.0;   // render loop time spent waiting on the writer
+
+    // Swapchains replaced by a resize, kept until every frame that used them is done
+    struct RetiredSwapchain {
+        VkSwapchainKHR swapchain;
+        std::vector<VkImageView> imageViews;
+        std::vector<VkFramebuffer> framebuffers;
+        uint64_t retiredAt;   // frameNumber at retirement; earlier frames may use it
+    };
+    std::vector<RetiredSwapchain> retiredSwapchains;
+
     // Render and Frames
     VkRenderPass renderPass = VK_NULL_HANDLE;
     std::vector<VkFramebuffer> swapchainFramebuffers;
 
     // Pipeline
+    VkDescriptorSetLayout cameraSetLayout = VK_NULL_HANDLE;   // set 0: CameraUniforms
+    VkDescriptorSetLayout hudSetLayout = VK_NULL_HANDLE;      // set 1: HUD font atlas
     VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    std::string pipelineCachePath;
+    std::thread pipelineThread;              // startup pipeline build, joined before the first frame
+    std::exception_ptr pipelineError;
     VkPipeline landerPipeline = VK_NULL_HANDLE;    
+    VkPipeline landerInstancedPipeline = VK_NULL_HANDLE;
     VkPipeline terrainPipeline = VK_NULL_HANDLE;
     VkPipeline starsPipeline = VK_NULL_HANDLE;
+    VkPipeline starsQuadPipeline = VK_NULL_HANDLE;
     VkPipeline particlePipeline = VK_NULL_HANDLE;
+    VkPipeline particleQuadPipeline = VK_NULL_HANDLE;
     VkPipeline hudPipeline = VK_NULL_HANDLE;
     
     // Command pool, sync, and buffers
     VkCommandPool commandPool = VK_NULL_HANDLE;
     std::vector<VkCommandBuffer> commandBuffers;
+    // One pool and secondary per pass per frame in flight. A pass is recorded by a single
+    // worker, so pools are never shared between threads and are reset whole.
+    std::array<std::array<VkCommandPool, DRAW_PASS_COUNT>, MAX_FRAMES_IN_FLIGHT> passCommandPools{};
+    std::array<std::array<VkCommandBuffer, DRAW_PASS_COUNT>, MAX_FRAMES_IN_FLIGHT> passCommandBuffers{};
+    std::array<bool, MAX_FRAMES_IN_FLIGHT> staticPassDirty{};
+    FrameDrawData frameDraw;
 
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkFence> inFlightFences;
-    uint32_t currentFrame = 0;
+    // Frame timeline: frame N (frameNumber N) signals N + 1 when the GPU finishes it, so this
+    // one counter tells which slots, ring regions and retired swapchains are free again
+    VkSemaphore frameTimeline = VK_NULL_HANDLE;
+    uint64_t completedFrames = 0;   // last timeline value seen
+    uint32_t currentFrame = 0;  // cycles through options.framesInFlight slots
+    uint64_t frameNumber = 0;   // frames submitted so far
+
+    // Latency: input is sampled after the limiter, just before the frame is simulated and
+    // recorded. Sample-to-submit is always measured; sample-to-present
+    // needs VK_GOOGLE_display_timing, whose present times share steady_clock's CLOCK_MONOTONIC.
+    VkPresentModeKHR activePresentMode = VK_PRESENT_MODE_FIFO_KHR;
+    std::chrono::steady_clock::time_point nextFrameDeadline{};
+    std::chrono::steady_clock::time_point inputSampleTime{};   // epoch: no input sampled (benchmarks)
+    std::array<std::chrono::steady_clock::time_point, LATENCY_HISTORY> presentSampleTimes{};
+    PFN_vkGetPastPresentationTimingGOOGLE getPastPresentationTiming = nullptr;
+    std::vector<float> submitLatencyMs;
+    std::vector<float> presentLatencyMs;
+
+    // Input: the GLFW key callback queues timestamped control transitions, and the fixed
+    // lander ticks consume them at the tick they fall in. Events are also pumped while the
+    // loop waits on the frame timeline or limiter, so timestamps stay ~1 ms accurate at any FPS.
+    SpscQueue<InputEvent, INPUT_QUEUE_SIZE> inputQueue;
+    std::array<int, CONTROL_COUNT> controlKeysDown{};   // producer: keys held per control
+    std::array<bool, CONTROL_COUNT> controlHeld{};      // consumer: state at the current tick
+    uint64_t simTicks = 0;                              // lander ticks run since start
+    uint64_t droppedInputEvents = 0;
+
+    // GPU timestamps: GPU_QUERIES_PER_FRAME queries per frame slot, read back once the
+    // slot's previous frame has finished, so results lag options.framesInFlight frames and never stall
+    VkQueryPool timestampPool = VK_NULL_HANDLE;
+    float timestampPeriod = 1.0f;      // ns per tick
+    uint64_t timestampMask = ~0ull;    // timestampValidBits of the graphics queue
+    std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> timestampFrame{};   // frameNumber + 1 of the slot's last submit, 0 = none
+    std::array<float, GPU_SECTION_COUNT> gpuSectionMs{};
+    std::ofstream gpuProfileCsv;
+
+    // Static geometry uploads: staging copies into DEVICE_LOCAL buffers on the transfer
+    // queue. The next frame waits on uploadSemaphore; uploadFence frees the staging memory.
+    VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+    VkCommandBuffer uploadCmd = VK_NULL_HANDLE;
+    VkFence uploadFence = VK_NULL_HANDLE;
+    VkSemaphore uploadSemaphore = VK_NULL_HANDLE;
+    bool uploadSemaphorePending = false;
+    bool uploadInFlight = false;
+    std::vector<std::pair<VkBuffer, MemoryAllocation>> stagingBuffers;
     
     // VkBuffer triangleVertexBuffer = VK_NULL_HANDLE;
     // VkDeviceMemory triangleVertexMemory = VK_NULL_HANDLE;
@@ -187,34 +1484,66 @@ private:
     bool framebufferResized = false;
 
     VkBuffer landerVertexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory landerVertexMemory = VK_NULL_HANDLE;
+    MemoryAllocation landerVertexMemory;
     uint32_t landerVertexCount = 0;
     
     VkBuffer landingPadVertexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory landingPadVertexMemory = VK_NULL_HANDLE;
+    MemoryAllocation landingPadVertexMemory;
     uint32_t landingPadVertexCount = 0;
 
     VkBuffer terrainVertexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory terrainVertexMemory = VK_NULL_HANDLE;
+    MemoryAllocation terrainVertexMemory;
     uint32_t terrainVertexCount = 0;   
     
     VkBuffer starsVertexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory starsVertexMemory = VK_NULL_HANDLE;
+    MemoryAllocation starsVertexMemory;
     uint32_t starsVertexCount = 0;
 
-    VkBuffer particleVertexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory particleVertexMemory = VK_NULL_HANDLE;
-
-    VkBuffer hudVertexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory hudVertexMemory = VK_NULL_HANDLE;
+    // Culling: element buckets of the static streams, and this frame's indirect draws
+    CullBuckets starBuckets;
+    CullBuckets terrainBuckets;        // over terrain points; each point is two strip vertices
+    FrameAllocation staticDraws;       // STATIC_DRAW_COUNT commands, fixed offset per frame slot
+    bool drawIndirectFirstInstance = false;
+
+    // HUD font: SDF atlas sampled by the HUD pipeline
+    VkImage fontAtlasImage = VK_NULL_HANDLE;
+    MemoryAllocation fontAtlasMemory;
+    VkImageView fontAtlasView = VK_NULL_HANDLE;
+    VkSampler fontSampler = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet hudDescriptorSet = VK_NULL_HANDLE;
+    std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> cameraDescriptorSets{};
+
+    // Frame ring: region i belongs to frame slot i, so the CPU only writes memory whose
+    // previous reader has passed on frameTimeline
+    VkBuffer frameRingBuffer = VK_NULL_HANDLE;
+    MemoryAllocation frameRingMemory;
+    uint8_t* frameRingMapped = nullptr;
+    VkDeviceSize frameRingHead = 0;   // next free byte in the current region
+    VkDeviceSize frameRingEnd = 0;
 
     Lander lander;  
+    std::vector<FleetLander> fleet;   // options.fleetSize autopiloted landers
     std::vector<glm::vec2> terrainPoints;
     float landingPadX = 0.0f;
     std::vector<StarVertex> stars;
     std::vector<Particle> particles;
-    float particleAccumulator = 0.0f;
+    size_t particleCount = 0;
+    std::vector<ParticleBlock> particleBlocks;
+
+    // Spatial hash: particles are counting-sorted by bucket, so bucket k occupies
+    // particles[bucketStart[k] .. bucketStart[k + 1])
+    std::vector<Particle> sortedParticles;       // scatter target, swapped with particles
+    std::vector<uint32_t> particleKeys;          // bucket of each particle
+    std::vector<uint32_t> blockBucketOffsets;    // [block][bucket] histogram, then scatter cursor
+    std::vector<uint32_t> bucketStart;           // PARTICLE_HASH_BUCKETS + 1 prefix sums
+    uint32_t particleFrame = 0;
+    std::array<Emitter, static_cast<size_t>(EmitterId::Count)> emitters;
+    SimState lastEmitterState = SimState::Flying;
     std::mt19937 rng{42};
+
+    WorkerPool workers;
+    MemoryAllocator memoryAllocator;
     
     glm::vec2 cameraPos{0.0f, 0.0f};
     float cameraZoom = 1.0f;
@@ -232,6 +1561,7 @@ private:
         // resize callback to trigger swapchain recreation
         glfwSetWindowUserPointer(window, this);
         glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+        glfwSetKeyCallback(window, keyCallback);
     }
 
     void initVulkan() {
@@ -239,45 +1569,85 @@ private:
         createSurface();
         pickPhysicalDevice();
         createLogicalDevice();
+        memoryAllocator.init(device, physicalDevice);
         createSwapchain();
         createImageViews();
         createRenderPass();
         createFramebuffers();
+        createCapture();
+        createDescriptorSetLayouts();
         createPipelineLayout();
-        createPipelines();
+        createPipelineCache();
+        startPipelineBuild();
         createCommandPool();
         createCommandBuffers();
         createSyncObjects();
-        createLanderGeometry();
+        createTimestampQueries();
+        createUploadObjects();
+    }
+
+    // Pipelines compile in the background while the rest of Vulkan init and sim setup
+    // (terrain, static uploads) run on the main thread
+    void startPipelineBuild() {
+        pipelineThread = std::thread([this] {
+            try {
+                auto start = std::chrono::steady_clock::now();
+                createPipelines();
+                std::printf("Pipelines created in %.1f ms\n", std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count());
+            } catch (...) {
+                pipelineError = std::current_exception();
+            }
+        });
+    }
+
+    void finishPipelineBuild() {
+        pipelineThread.join();
+        if (pipelineError) std::rethrow_exception(pipelineError);
     }
 
     void initSim() {
         generateTerrain();
         generateStars();
+        createDescriptorPool();
+        beginStaticUploads();
         createLanderGeometry();
         createTerrainGeometry();
         createStarsGeometry();
         createLandingPadGeometry();
+        createFontAtlas();
+        endStaticUploads();
 
+        fleet.resize(options.fleetSize);
         particles.resize(MAX_PARTICLES);
-        VkDeviceSize particleBufSize = sizeof(ParticleVertex) * MAX_PARTICLES;
-        createBuffer(particleBufSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                     particleVertexBuffer, particleVertexMemory);
-
-        VkDeviceSize hudBufSize = sizeof(glm::vec2) * 1024;
-        createBuffer(hudBufSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                     hudVertexBuffer, hudVertexMemory);
+        sortedParticles.resize(MAX_PARTICLES);
+        particleKeys.resize(MAX_PARTICLES);
+        bucketStart.assign(PARTICLE_HASH_BUCKETS + 1, 0);
+        initEmitters();
+        createFrameRing();
+        memoryAllocator.printStats();
 
         resetLander();
     }
 
     void mainLoop() {
         auto lastTime = std::chrono::high_resolution_clock::now();
-        
+        // The sim clock counts from startTime; startup isn't flight time
+        simTicks = static_cast<uint64_t>(secondsSinceStart(std::chrono::steady_clock::now()) * SIM_TICK_RATE);
+
+        bool traceKeyDown = false;
         while (!glfwWindowShouldClose(window)) {
-            glfwPollEvents();
+            PROFILE_SCOPE("frame");
+            // By default input, sim and particle updates overlap the GPU finishing the slot's
+            // previous frame, and drawFrame() waits only before it writes the slot's resources.
+            // Latency-tuned runs wait here instead, so input is sampled right before recording.
+            if (waitBeforeInput()) waitForFrameSlot();
+            limitFrameRate();
+            {
+                PROFILE_SCOPE("glfwPollEvents");
+                glfwPollEvents();
+            }
+            inputSampleTime = std::chrono::steady_clock::now();
 
             auto now = std::chrono::high_resolution_clock::now();
             float dt = std::chrono::duration<float>(now-lastTime).count();
@@ -290,47 +1660,209 @@ private:
             if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
                 resetLander();
 
+            // F9 dumps the CPU trace so far, on the press edge
+            bool traceKey = glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS;
+            if (traceKey && !traceKeyDown) writeCpuTrace();
+            traceKeyDown = traceKey;
+
             // handleInput(dt);
-            updatePhysics(dt);
+            stepLander(secondsSinceStart(std::chrono::steady_clock::now()));
+            updateFleet(dt);
             updateParticles(dt);
             updateCamera(dt);
             drawFrame();
         }
         // wait for gpu before cleanup
         vkDeviceWaitIdle(device);
+        collectPresentTimings();
+        printLatencyStats();
+        if (droppedInputEvents > 0)
+            std::printf("Input queue overflowed: %llu key events dropped\n",
+                        static_cast<unsigned long long>(droppedInputEvents));
+    }
+
+    // Waits until the GPU has finished the frame that last used currentFrame's slot. With a
+    // window, polls events meanwhile, so key transitions are timestamped when they happen
+    // rather than when the next frame starts.
+    void waitForFrameSlot() {
+        if (frameNumber < options.framesInFlight) return;
+        uint64_t value = frameNumber + 1 - options.framesInFlight;
+        vkGetSemaphoreCounterValue(device, frameTimeline, &completedFrames);
+        if (completedFrames >= value) return;
+
+        PROFILE_SCOPE("waitForFrame");
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &frameTimeline;
+        waitInfo.pValues = &value;
+        uint64_t timeout = window ? INPUT_PUMP_INTERVAL_NS : UINT64_MAX;
+        VkResult result;
+        while ((result = vkWaitSemaphores(device, &waitInfo, timeout)) == VK_TIMEOUT)
+            glfwPollEvents();
+        if (result != VK_SUCCESS) throw std::runtime_error("Failed to wait for frame timeline");
+        vkGetSemaphoreCounterValue(device, frameTimeline, &completedFrames);
+    }
+
+    bool waitBeforeInput() const { return options.fpsLimit > 0.0 || options.framesInFlight == 1; }
+
+    double secondsSinceStart(std::chrono::steady_clock::time_point t) const {
+        return std::chrono::duration<double>(t - startTime).count();
+    }
+
+    // Paces the loop at --fps-limit. At or just under the display rate with FIFO, frames
+    // no longer queue up behind vsync, so each one is shown about a refresh after its input.
+    void limitFrameRate() {
+        if (options.fpsLimit <= 0.0) return;
+        PROFILE_SCOPE("frameLimiter");
+        auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / options.fpsLimit));
+        auto now = std::chrono::steady_clock::now();
+        if (nextFrameDeadline + period < now) nextFrameDeadline = now;   // fell behind: don't catch up in a burst
+        if (window) {
+            // Sleep in the event wait, so keys pressed meanwhile are stamped on arrival
+            while ((now = std::chrono::steady_clock::now()) < nextFrameDeadline)
+                glfwWaitEventsTimeout(std::chrono::duration<double>(nextFrameDeadline - now).count());
+        } else {
+            std::this_thread::sleep_until(nextFrameDeadline);
+        }
+        nextFrameDeadline += period;
+    }
+
+    // Present times arrive a few frames late; entries that fell out of the history are dropped
+    void collectPresentTimings() {
+        if (!getPastPresentationTiming || !swapchain) return;
+        uint32_t count = 0;
+        getPastPresentationTiming(device, swapchain, &count, nullptr);
+        if (count == 0) return;
+        std::vector<VkPastPresentationTimingGOOGLE> timings(count);
+        getPastPresentationTiming(device, swapchain, &count, timings.data());
+        for (uint32_t i = 0; i < count; i++) {
+            const auto& t = timings[i];
+            if (t.presentID + LATENCY_HISTORY <= frameNumber) continue;
+            auto sampled = presentSampleTimes[t.presentID % LATENCY_HISTORY];
+            if (sampled.time_since_epoch().count() == 0) continue;
+            auto presented = std::chrono::nanoseconds(t.actualPresentTime);
+            presentLatencyMs.push_back(std::chrono::duration<float, std::milli>(
+                presented - sampled.time_since_epoch()).count());
+        }
+    }
+
+    void printLatencyStats() {
+        auto summary = [](std::vector<float>& ms) {
+            std::sort(ms.begin(), ms.end());
+            double sum = 0.0;
+            for (float v : ms) sum += v;
+            char text[96];
+            std::snprintf(text, sizeof(text), "avg %.2f ms, p50 %.2f, p99 %.2f (%zu frames)",
+                          sum / ms.size(), ms[ms.size() / 2], ms[ms.size() * 99 / 100], ms.size());
+            return std::string(text);
+        };
+        if (submitLatencyMs.empty()) return;
+        std::printf("Latency, %s, %u frames in flight", presentModeName(activePresentMode), options.framesInFlight);
+        if (options.fpsLimit > 0.0) std::printf(", limited to %.1f fps", options.fpsLimit);
+        std::printf("\n  input to submit:  %s\n", summary(submitLatencyMs).c_str());
+        if (!presentLatencyMs.empty())
+            std::printf("  input to present: %s\n", summary(presentLatencyMs).c_str());
+        else
+            std::printf("  input to present: not measured (needs %s)\n", VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+    }
+
+    static const char* presentModeName(VkPresentModeKHR mode) {
+        switch (mode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo-relaxed";
+        default: return "other";
+        }
+    }
+
+    bool headless() const { return options.headlessFrames > 0; }
+
+    // No input and a fixed step: the same seed always renders the same frames
+    void runHeadless() {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < options.headlessFrames; i++) {
+            stepLander((i + 1) * double(HEADLESS_DT));
+            updateFleet(HEADLESS_DT);
+            updateParticles(HEADLESS_DT);
+            updateCamera(HEADLESS_DT);
+            drawFrame();
+        }
+        vkDeviceWaitIdle(device);
+
+        std::printf("Rendered %u headless frames (%ux%u) in %.1f ms\n", options.headlessFrames,
+            swapchainExtent.width, swapchainExtent.height, std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count());
+    }
+
+    void writeCpuTrace() {
+#ifdef LUNA_CPU_PROFILER
+        if (options.cpuTracePath.empty()) return;
+        if (CpuProfiler::instance().writeChromeTrace(options.cpuTracePath))
+            std::printf("CPU trace written to %s\n", options.cpuTracePath.c_str());
+        else
+            std::cerr << "Failed to write CPU trace " << options.cpuTracePath << std::endl;
+#endif
     }
 
     void cleanup() {
+        finishStaticUploads(true);
+        vkDestroySemaphore(device, uploadSemaphore, nullptr);
+        vkDestroyFence(device, uploadFence, nullptr);
+        vkDestroyCommandPool(device, transferCommandPool, nullptr);
+
         destroyBuffer(landerVertexBuffer, landerVertexMemory);
         destroyBuffer(landingPadVertexBuffer, landingPadVertexMemory);
         destroyBuffer(terrainVertexBuffer, terrainVertexMemory);
         destroyBuffer(starsVertexBuffer, starsVertexMemory);
-        destroyBuffer(particleVertexBuffer, particleVertexMemory);
-        destroyBuffer(hudVertexBuffer, hudVertexMemory);
+        destroyBuffer(frameRingBuffer, frameRingMemory);
+        for (uint32_t i = 0; i < CAPTURE_RING_SIZE; i++)
+            destroyBuffer(captureBuffers[i], captureMemory[i]);
+        vkDestroySampler(device, fontSampler, nullptr);
+        vkDestroyImageView(device, fontAtlasView, nullptr);
+        vkDestroyImage(device, fontAtlasImage, nullptr);
+        memoryAllocator.free(fontAtlasMemory);
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 
         for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
             vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
             vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-            vkDestroyFence(device, inFlightFences[i], nullptr);
         }
+        vkDestroySemaphore(device, frameTimeline, nullptr);
 
+        if (timestampPool) vkDestroyQueryPool(device, timestampPool, nullptr);
         vkDestroyCommandPool(device, commandPool, nullptr);
+        for (auto& pools : passCommandPools)
+            for (VkCommandPool pool : pools) vkDestroyCommandPool(device, pool, nullptr);
+        releaseRetiredSwapchains(true);
         cleanupSwapchain();
+        if (swapchain) vkDestroySwapchainKHR(device, swapchain, nullptr);
+        if (headless()) {
+            for (size_t i = 0; i < swapchainImages.size(); i++) {
+                vkDestroyImage(device, swapchainImages[i], nullptr);
+                memoryAllocator.free(offscreenImageMemory[i]);
+            }
+        }
 
-        vkDestroyPipeline(device, landerPipeline, nullptr);
-        vkDestroyPipeline(device, terrainPipeline, nullptr);
-        vkDestroyPipeline(device, starsPipeline, nullptr);
-        vkDestroyPipeline(device, particlePipeline, nullptr);       
-        vkDestroyPipeline(device, hudPipeline, nullptr);  
+        destroyPipelines();
         vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, cameraSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, hudSetLayout, nullptr);
+        savePipelineCache();
+        vkDestroyPipelineCache(device, pipelineCache, nullptr);
         vkDestroyRenderPass(device, renderPass, nullptr);
 
+        memoryAllocator.destroy();
         vkDestroyDevice(device, nullptr);
-        vkDestroySurfaceKHR(instance, surface, nullptr);
+        if (surface) vkDestroySurfaceKHR(instance, surface, nullptr);
         vkDestroyInstance(instance, nullptr);
 
-        glfwDestroyWindow(window);
-        glfwTerminate();
+        if (window) {
+            glfwDestroyWindow(window);
+            glfwTerminate();
+        }
     }
 
     // ------------------------------------------------------------------------------------
@@ -342,6 +1874,12 @@ private:
         app->framebufferResized = true;
     }
 
+    static void keyCallback(GLFWwindow* w, int key, int, int action, int) {
+        if (action == GLFW_REPEAT) return;
+        auto app = reinterpret_cast<LunaApp*>(glfwGetWindowUserPointer(w));
+        app->queueKey(key, action == GLFW_PRESS);
+    }
+
     // ------------------------------------------------------------------------------------
     // initVulkan functions
     // ------------------------------------------------------------------------------------
@@ -352,10 +1890,11 @@ private:
         appInfo.pApplicationName = "Luna";
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        appInfo.apiVersion = VK_API_VERSION_1_2;   // timeline semaphores
 
+        // Headless needs no surface extensions, and GLFW is never initialized
         uint32_t glfwExtCount = 0;
-        const char** glfwExts = glfwGetRequiredInstanceExtensions(&glfwExtCount);
+        const char** glfwExts = headless() ? nullptr : glfwGetRequiredInstanceExtensions(&glfwExtCount);
 
         VkInstanceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -370,6 +1909,7 @@ private:
     }
 
     void createSurface() {
+        if (headless()) return;
         if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create window surface");
         }
@@ -400,6 +1940,7 @@ private:
 
     void createLogicalDevice() {
         auto indices = findQueueFamilies(physicalDevice);
+        queueFamilies = indices;
         float priority = 1.0f;
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
@@ -407,6 +1948,8 @@ private:
         uniqueFamilies.push_back(indices.graphicsFamily.value());
         if (indices.presentFamily.value() != indices.graphicsFamily.value())
             uniqueFamilies.push_back(indices.presentFamily.value());
+        if (indices.transferFamily && indices.transferFamily.value() != indices.presentFamily.value())
+            uniqueFamilies.push_back(indices.transferFamily.value());
 
         for (uint32_t family : uniqueFamilies) {
             VkDeviceQueueCreateInfo queueInfo{};
@@ -421,25 +1964,61 @@ private:
         VkPhysicalDeviceFeatures supported;
         vkGetPhysicalDeviceFeatures(physicalDevice, &supported);
         if (supported.largePoints) deviceFeatures.largePoints = VK_TRUE;
+        // Culled quad sprites start at a non-zero instance; without it they draw from 0
+        drawIndirectFirstInstance = supported.drawIndirectFirstInstance == VK_TRUE;
+        deviceFeatures.drawIndirectFirstInstance = supported.drawIndirectFirstInstance;
+
+        std::vector<const char*> extensions;
+        bool displayTiming = false;
+        if (!headless()) {
+            extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+            uint32_t extCount = 0;
+            vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extCount, nullptr);
+            std::vector<VkExtensionProperties> available(extCount);
+            vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extCount, available.data());
+            for (const auto& ext : available) {
+                if (std::string(ext.extensionName) == VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME) {
+                    extensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+                    displayTiming = true;
+                }
+            }
+        }
+        VkPhysicalDeviceVulkan12Features features12{};
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        features12.timelineSemaphore = VK_TRUE;
 
-        const char* extensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pNext = &features12;
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
         createInfo.pEnabledFeatures = &deviceFeatures;
-        createInfo.enabledExtensionCount = 1;
-        createInfo.ppEnabledExtensionNames = extensions;
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
         if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS)
             throw std::runtime_error("Failed to create logical device");
+        if (displayTiming) {
+            getPastPresentationTiming = reinterpret_cast<PFN_vkGetPastPresentationTimingGOOGLE>(
+                vkGetDeviceProcAddr(device, "vkGetPastPresentationTimingGOOGLE"));
+        }
         vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
         vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+        transferQueue = graphicsQueue;
+        if (indices.transferFamily) {
+            vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+            std::cout << "Transfer queue family: " << indices.transferFamily.value() << std::endl;
+        }
     };
 
     void createSwapchain() {
+        if (headless()) {
+            createOffscreenTargets();
+            return;
+        }
         auto support = querySwapchainSupport(physicalDevice);
         auto format = chooseSwapFormat(support.formats);
         auto mode = chooseSwapPresentMode(support.presentModes);
+        activePresentMode = mode;
         auto extent = chooseSwapExtent(support.capabilities);
 
         uint32_t imageCount = support.capabilities.minImageCount + 1;
@@ -455,6 +2034,11 @@ private:
         createInfo.imageExtent = extent;
         createInfo.imageArrayLayers = 1;
         createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        if (capturing()) {
+            if (!(support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+                throw std::runtime_error("Swapchain images can't be copied from; capture unavailable");
+            createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
 
         auto indices = findQueueFamilies(physicalDevice);
         uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
@@ -470,7 +2054,7 @@ private:
         createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
         createInfo.presentMode = mode;
         createInfo.clipped = VK_TRUE;
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
+        createInfo.oldSwapchain = swapchain;   // lets the driver hand over images on resize
 
         if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapchain) != VK_SUCCESS)
             throw std::runtime_error("Failed to create swapchain");
@@ -482,6 +2066,197 @@ private:
         swapchainExtent = extent;        
     }
 
+    // Headless render targets. R8G8B8A8_SRGB encodes like the usual B8G8R8A8_SRGB
+    // swapchain, and its byte order reads back as RGB without swizzling.
+    void createOffscreenTargets() {
+        swapchainImageFormat = VK_FORMAT_R8G8B8A8_SRGB;
+        swapchainExtent = {options.headlessWidth, options.headlessHeight};
+        swapchainImages.resize(options.framesInFlight);
+        offscreenImageMemory.resize(options.framesInFlight);
+
+        for (uint32_t i = 0; i < options.framesInFlight; i++) {
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.format = swapchainImageFormat;
+            imageInfo.extent = {swapchainExtent.width, swapchainExtent.height, 1};
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            if (vkCreateImage(device, &imageInfo, nullptr, &swapchainImages[i]) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create offscreen image");
+
+            VkMemoryRequirements memReqs;
+            vkGetImageMemoryRequirements(device, swapchainImages[i], &memReqs);
+            offscreenImageMemory[i] = memoryAllocator.allocate(memReqs,
+                findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT), false);
+            vkBindImageMemory(device, swapchainImages[i], offscreenImageMemory[i].memory, offscreenImageMemory[i].offset);
+        }
+    }
+
+    bool capturing() const { return headless() || !options.capturePath.empty(); }
+
+    // Keeps stdout for frames only. Runs before any init, so every log line that would
+    // have gone there, device info included, lands on stderr instead.
+    void redirectStdout() {
+#ifndef _WIN32
+        std::fflush(stdout);
+        int fd = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        captureStdout = fdopen(fd, "wb");
+#else
+        captureStdout = stdout;
+#endif
+    }
+
+    // Sized for the first swapchain extent; the stream can't change size mid-way
+    void createCapture() {
+        if (!capturing()) return;
+
+        bool bgra;
+        switch (swapchainImageFormat) {
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM: bgra = true; break;
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_R8G8B8A8_UNORM: bgra = false; break;
+        default: throw std::runtime_error("Capture needs an 8-bit RGBA or BGRA swapchain");
+        }
+
+        captureExtent = swapchainExtent;
+        VkDeviceSize size = VkDeviceSize(captureExtent.width) * captureExtent.height * 4;
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(physicalDevice, &props);
+        VkDeviceSize atom = props.limits.nonCoherentAtomSize;
+        for (uint32_t i = 0; i < CAPTURE_RING_SIZE; i++) {
+            VkBufferCreateInfo bufferInfo{};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = size;
+            bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            if (vkCreateBuffer(device, &bufferInfo, nullptr, &captureBuffers[i]) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create capture buffer");
+
+            VkMemoryRequirements memReqs;
+            vkGetBufferMemoryRequirements(device, captureBuffers[i], &memReqs);
+            // The writer reads every byte: uncached (often write-combined) memory is slow
+            // enough to make it fall behind, so take cached memory where there is any
+            uint32_t type = findCaptureMemoryType(memReqs.memoryTypeBits, captureCoherent);
+            // Non-coherent invalidation works on whole atoms; keep them to this allocation
+            memReqs.alignment = std::max(memReqs.alignment, atom);
+            memReqs.size = (memReqs.size + atom - 1) / atom * atom;
+            captureMemory[i] = memoryAllocator.allocate(memReqs, type);
+            vkBindBufferMemory(device, captureBuffers[i], captureMemory[i].memory, captureMemory[i].offset);
+        }
+
+        if (!options.outputDir.empty()) {
+            std::error_code ec;
+            std::filesystem::create_directories(options.outputDir, ec);
+            if (ec) throw std::runtime_error("Failed to create output directory " + options.outputDir);
+        }
+
+        std::FILE* stream = nullptr;
+        if (options.capturePath == "-") {
+            stream = captureStdout;
+        } else if (!options.capturePath.empty()) {
+            stream = std::fopen(options.capturePath.c_str(), "wb");
+        }
+        if (!options.capturePath.empty() && !stream)
+            throw std::runtime_error("Failed to open capture output " + options.capturePath);
+
+        CaptureFormat format = !stream ? CaptureFormat::None
+                             : options.captureRaw ? CaptureFormat::Raw : CaptureFormat::Y4m;
+        double fps = captureFrameRate();
+        if (format == CaptureFormat::Y4m && fps <= 0.0) {
+            throw std::runtime_error("Windowed Y4M capture needs a fixed frame rate: "
+                                     "use --fps-limit or --present fifo, or --capture-raw");
+        }
+        captureWriter.start(captureExtent.width, captureExtent.height, bgra, CAPTURE_RING_SIZE,
+                            stream, format, options.outputDir,
+                            static_cast<uint32_t>(std::lround(fps * 1000.0)), 1000);
+    }
+
+    uint32_t findCaptureMemoryType(uint32_t typeFilter, bool& coherent) {
+        VkPhysicalDeviceMemoryProperties memProps;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
+        VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
+            VkMemoryPropertyFlags flags = memProps.memoryTypes[i].propertyFlags;
+            if ((typeFilter & (1 << i)) && (flags & cached) == cached) {
+                coherent = (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+                return i;
+            }
+        }
+        coherent = true;
+        return findMemoryType(typeFilter, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
+
+    // Rate frames are captured at, or 0 when uncapped. Every rendered frame is captured, so
+    // this is the sim step headless, else the limiter and/or the vsync'd display rate.
+    double captureFrameRate() const {
+        if (headless()) return 1.0 / HEADLESS_DT;
+        double refresh = 0.0;
+        if (activePresentMode == VK_PRESENT_MODE_FIFO_KHR) {
+            GLFWmonitor* monitor = glfwGetWindowMonitor(window);
+            if (!monitor) monitor = glfwGetPrimaryMonitor();
+            const GLFWvidmode* mode = monitor ? glfwGetVideoMode(monitor) : nullptr;
+            if (mode) refresh = mode->refreshRate;
+        }
+        if (options.fpsLimit > 0.0) return refresh > 0.0 ? std::min(options.fpsLimit, refresh) : options.fpsLimit;
+        return refresh;
+    }
+
+    // Picks this frame's ring buffer. Waits only when the writer has fallen a whole ring behind.
+    void beginCapture() {
+        SlotCapture& slot = slotCaptures[currentFrame];
+        slot.buffer = -1;
+        if (!capturing()) return;
+        if (swapchainExtent.width != captureExtent.width || swapchainExtent.height != captureExtent.height) {
+            skippedCaptureFrames++;
+            return;
+        }
+        PROFILE_SCOPE("captureAcquire");
+        captureStallMs += captureWriter.acquire(nextCaptureBuffer);
+        slot.buffer = static_cast<int32_t>(nextCaptureBuffer);
+        nextCaptureBuffer = (nextCaptureBuffer + 1) % CAPTURE_RING_SIZE;
+    }
+
+    // Call once waitForFrameSlot() has returned: the copy is complete and the buffer can be read
+    void collectCapture(uint32_t frame) {
+        SlotCapture& slot = slotCaptures[frame];
+        if (slot.buffer < 0) return;
+        const MemoryAllocation& memory = captureMemory[slot.buffer];
+        if (!captureCoherent) {
+            VkMappedMemoryRange range{};
+            range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+            range.memory = memory.memory;
+            range.offset = memory.offset;
+            range.size = memory.size;
+            vkInvalidateMappedMemoryRanges(device, 1, &range);
+        }
+        const auto* pixels = static_cast<const uint8_t*>(memory.mapped);
+        captureWriter.push({pixels, static_cast<uint32_t>(slot.buffer), slot.frame});
+        capturedFrames++;
+        slot.buffer = -1;
+    }
+
+    void finishCapture() {
+        if (!capturing()) return;
+        vkDeviceWaitIdle(device);
+        // Oldest first: the slot drawFrame() would use next holds the earliest frame
+        for (uint32_t i = 0; i < options.framesInFlight; i++)
+            collectCapture((currentFrame + i) % options.framesInFlight);
+        bool ok = captureWriter.finish();
+
+        std::fprintf(stderr, "Captured %llu frames (%llu skipped after a resize), %.1f ms waiting on the writer\n",
+                     static_cast<unsigned long long>(capturedFrames),
+                     static_cast<unsigned long long>(skippedCaptureFrames), captureStallMs);
+        if (!ok) std::fprintf(stderr, "Capture output is incomplete: a write failed\n");
+    }
+
     void createImageViews() {
         swapchainImageViews.resize(swapchainImages.size());
         for (size_t i = 0; i < swapchainImages.size(); i++) {
@@ -511,7 +2286,8 @@ private:
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // ready to display
+        colorAttachment.finalLayout = headless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL   // ready to read back
+                                                 : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;       // ready to display
 
         VkAttachmentReference colorRef{};
         colorRef.attachment = 0;
@@ -559,6 +2335,49 @@ private:
                 throw std::runtime_error("Failed to create framebuffer");
         }
     }
+
+    void createDescriptorSetLayouts() {
+        VkDescriptorSetLayoutBinding cameraBinding{};
+        cameraBinding.binding = 0;
+        cameraBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        cameraBinding.descriptorCount = 1;
+        cameraBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+        VkDescriptorSetLayoutBinding atlasBinding{};
+        atlasBinding.binding = 0;
+        atlasBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        atlasBinding.descriptorCount = 1;
+        atlasBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &cameraBinding;
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &cameraSetLayout) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create camera descriptor set layout");
+
+        layoutInfo.pBindings = &atlasBinding;
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &hudSetLayout) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create HUD descriptor set layout");
+    }
+
+    // Camera sets for every frame in flight plus the HUD atlas set
+    void createDescriptorPool() {
+        VkDescriptorPoolSize poolSizes[2]{};
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        poolSizes[0].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[1].descriptorCount = 1;
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT + 1;
+        poolInfo.poolSizeCount = 2;
+        poolInfo.pPoolSizes = poolSizes;
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create descriptor pool");
+    }
+
     void createPipelineLayout() {
         VkPushConstantRange pushConstantRange{};
         pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -567,6 +2386,9 @@ private:
 
         VkPipelineLayoutCreateInfo layoutInfo{};
         layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        VkDescriptorSetLayout setLayouts[] = {cameraSetLayout, hudSetLayout};
+        layoutInfo.setLayoutCount = 2;
+        layoutInfo.pSetLayouts = setLayouts;
         layoutInfo.pushConstantRangeCount = 1;
         layoutInfo.pPushConstantRanges = &pushConstantRange;
 
@@ -574,8 +2396,87 @@ private:
             throw std::runtime_error("Failed to create pipeline layout");    
     }
 
+    // Seeds the pipeline cache from disk. The file is per device; its header must match
+    // this device and driver or the data is dropped, since some drivers misbehave on
+    // foreign cache blobs instead of rejecting them.
+    void createPipelineCache() {
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(physicalDevice, &props);
+
+        std::filesystem::path dir = options.pipelineCacheDir;
+        if (dir.empty()) {
+            if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+                dir = std::filesystem::path(xdg) / "luna-toy";
+            else if (const char* home = std::getenv("HOME"); home && *home)
+                dir = std::filesystem::path(home) / ".cache" / "luna-toy";
+            else
+                dir = ".";
+        }
+        char name[64];
+        std::snprintf(name, sizeof(name), "pipelines-%04x-%04x.bin", props.vendorID, props.deviceID);
+        pipelineCachePath = (dir / name).string();
+
+        std::vector<char> data;
+        std::ifstream file(pipelineCachePath, std::ios::ate | std::ios::binary);
+        if (file.is_open()) {
+            data.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(data.data(), data.size());
+        }
+
+        // Header: length, version, vendorID, deviceID (uint32 each), then the cache UUID
+        constexpr size_t HEADER_SIZE = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+        bool valid = false;
+        if (data.size() >= HEADER_SIZE) {
+            uint32_t header[4];
+            memcpy(header, data.data(), sizeof(header));
+            valid = header[0] >= HEADER_SIZE && header[0] <= data.size() &&
+                    header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+                    header[2] == props.vendorID && header[3] == props.deviceID &&
+                    memcmp(data.data() + sizeof(header), props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+        }
+        if (!data.empty())
+            std::cout << "Pipeline cache: " << (valid ? "loaded " : "discarded stale ")
+                      << data.size() << " bytes from " << pipelineCachePath << std::endl;
+
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = valid ? data.size() : 0;
+        cacheInfo.pInitialData = valid ? data.data() : nullptr;
+        if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create pipeline cache");
+    }
+
+    // Writes to a temporary file and renames it over the old one, so concurrent runs
+    // never read a half-written cache
+    void savePipelineCache() {
+        size_t size = 0;
+        if (vkGetPipelineCacheData(device, pipelineCache, &size, nullptr) != VK_SUCCESS || size == 0)
+            return;
+        std::vector<char> data(size);
+        if (vkGetPipelineCacheData(device, pipelineCache, &size, data.data()) != VK_SUCCESS)
+            return;
+
+        std::error_code ec;
+        std::filesystem::path path = pipelineCachePath;
+        std::filesystem::create_directories(path.parent_path(), ec);
+        std::filesystem::path tmp = path;
+        tmp += ".tmp" + std::to_string(std::random_device{}());
+        {
+            std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+            if (!file.write(data.data(), size)) {
+                std::cerr << "Failed to write pipeline cache " << tmp << std::endl;
+                file.close();
+                std::filesystem::remove(tmp, ec);
+                return;
+            }
+        }
+        std::filesystem::rename(tmp, path, ec);
+        if (ec) std::filesystem::remove(tmp, ec);
+    }
+
     void createPipelines() {
-        std::string shaderDir = SHADER_DIR;
+        std::vector<PipelineDesc> descs;
 
         {
             VkVertexInputBindingDescription binding{};
@@ -587,10 +2488,22 @@ private:
             attrs[0] = {0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex2D, pos)};
             attrs[1] = {1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex2D, color)};
 
-            landerPipeline = createPipeline(
-                shaderDir + "/shader.vert.spv", shaderDir + "/shader.frag.spv",
-                {binding}, attrs, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST
-            );
+            descs.push_back({&landerPipeline,
+                "shader.vert.spv", "shader.frag.spv",
+                {binding}, attrs, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, false});
+
+            // Same mesh, plus one LanderInstance per lander on binding 1
+            VkVertexInputBindingDescription instanceBinding{};
+            instanceBinding.binding = 1;
+            instanceBinding.stride = sizeof(LanderInstance);
+            instanceBinding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+            attrs.push_back({2, 1, VK_FORMAT_R32G32_SFLOAT, offsetof(LanderInstance, pos)});
+            attrs.push_back({3, 1, VK_FORMAT_R32_SFLOAT, offsetof(LanderInstance, angle)});
+            attrs.push_back({4, 1, VK_FORMAT_R8G8B8A8_UNORM, offsetof(LanderInstance, color)});
+            descs.push_back({&landerInstancedPipeline,
+                "shader_instanced.vert.spv", "shader.frag.spv",
+                {binding, instanceBinding}, attrs, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, false});
         }
 
         {
@@ -600,12 +2513,11 @@ private:
             binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
             std::vector<VkVertexInputAttributeDescription> attrs(1);
-            attrs[0] = {0, 0, VK_FORMAT_R32G32_SFLOAT, 0};
+            attrs[0] = {0, 0, VK_FORMAT_R16G16_UNORM, offsetof(TerrainVertex, pos)};
 
-            terrainPipeline = createPipeline(
-                shaderDir + "/terrain.vert.spv", shaderDir + "/terrain.frag.spv",
-                {binding}, attrs, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP
-            );
+            descs.push_back({&terrainPipeline,
+                "terrain.vert.spv", "terrain.frag.spv",
+                {binding}, attrs, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, false});
         }
 
         {
@@ -619,10 +2531,15 @@ private:
             attrs[1] = {1, 0, VK_FORMAT_R32_SFLOAT, offsetof(StarVertex, brightness)};
             attrs[2] = {2, 0, VK_FORMAT_R32_SFLOAT, offsetof(StarVertex, size)};
 
-            starsPipeline = createPipeline(
-                shaderDir + "/stars.vert.spv", shaderDir + "/stars.frag.spv",
-                {binding}, attrs, VK_PRIMITIVE_TOPOLOGY_POINT_LIST, true  // blending ON
-            );
+            descs.push_back({&starsPipeline,
+                "stars.vert.spv", "stars.frag.spv",
+                {binding}, attrs, VK_PRIMITIVE_TOPOLOGY_POINT_LIST, true});  // blending ON
+
+            // Same vertex data stepped per instance; 4 strip corners per star
+            binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+            descs.push_back({&starsQuadPipeline,
+                "stars_quad.vert.spv", "stars_quad.frag.spv",
+                {binding}, attrs, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, true});
         }
         
         {
@@ -631,31 +2548,39 @@ private:
             binding.stride = sizeof(ParticleVertex);
             binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-            std::vector<VkVertexInputAttributeDescription> attrs(3);
-            attrs[0] = {0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(ParticleVertex, pos)};
-            attrs[1] = {1, 0, VK_FORMAT_R32_SFLOAT, offsetof(ParticleVertex, life)};
-            attrs[2] = {2, 0, VK_FORMAT_R32_SFLOAT, offsetof(ParticleVertex, size)};
+            std::vector<VkVertexInputAttributeDescription> attrs(4);
+            attrs[0] = {0, 0, VK_FORMAT_R16G16_UNORM, offsetof(ParticleVertex, pos)};
+            attrs[1] = {1, 0, VK_FORMAT_R8_UNORM, offsetof(ParticleVertex, life)};
+            attrs[2] = {2, 0, VK_FORMAT_R8_UNORM, offsetof(ParticleVertex, size)};
+            attrs[3] = {3, 0, VK_FORMAT_R8_UNORM, offsetof(ParticleVertex, kind)};
+
+            descs.push_back({&particlePipeline,
+                "particles.vert.spv", "particles.frag.spv",
+                {binding}, attrs, VK_PRIMITIVE_TOPOLOGY_POINT_LIST, true});
 
-            particlePipeline = createPipeline(
-                shaderDir + "/particles.vert.spv", shaderDir + "/particles.frag.spv",
-                {binding}, attrs, VK_PRIMITIVE_TOPOLOGY_POINT_LIST, true
-            );
+            binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+            descs.push_back({&particleQuadPipeline,
+                "particles_quad.vert.spv", "particles_quad.frag.spv",
+                {binding}, attrs, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, true});
         }
 
         {
             VkVertexInputBindingDescription binding{};
             binding.binding = 0;
-            binding.stride = sizeof(glm::vec2);
+            binding.stride = sizeof(HudVertex);
             binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-            std::vector<VkVertexInputAttributeDescription> attrs(1);
-            attrs[0] = {0, 0, VK_FORMAT_R32G32_SFLOAT, 0};
+            std::vector<VkVertexInputAttributeDescription> attrs(3);
+            attrs[0] = {0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(HudVertex, pos)};
+            attrs[1] = {1, 0, VK_FORMAT_R16G16_UNORM, offsetof(HudVertex, uv)};
+            attrs[2] = {2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(HudVertex, color)};
 
-            hudPipeline = createPipeline(
-                shaderDir + "/hud.vert.spv", shaderDir + "/hud.frag.spv",
-                {binding}, attrs, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, true
-            );
+            descs.push_back({&hudPipeline,
+                "hud.vert.spv", "hud.frag.spv",
+                {binding}, attrs, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, true});
         }
+
+        createPipelineBatch(descs);
     }
 
     void createCommandPool() {
@@ -681,25 +2606,104 @@ private:
 
         if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
             throw std::runtime_error("Failed to allocate command buffers");
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = queueFamilies.graphicsFamily.value();
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+        for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++) {
+            for (size_t pass = 0; pass < DRAW_PASS_COUNT; pass++) {
+                if (vkCreateCommandPool(device, &poolInfo, nullptr, &passCommandPools[frame][pass]) != VK_SUCCESS)
+                    throw std::runtime_error("Failed to create pass command pool");
+                allocInfo.commandPool = passCommandPools[frame][pass];
+                if (vkAllocateCommandBuffers(device, &allocInfo, &passCommandBuffers[frame][pass]) != VK_SUCCESS)
+                    throw std::runtime_error("Failed to allocate secondary command buffers");
+            }
+        }
+        invalidateStaticPasses();
     }
 
     void createSyncObjects() {
         imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
         renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
 
         VkSemaphoreCreateInfo semInfo{};
         semInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        VkFenceCreateInfo fenceInfo{};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
+        // Binary semaphores stay for acquire and present, which can't use a timeline
         for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
             vkCreateSemaphore(device, &semInfo, nullptr, &imageAvailableSemaphores[i]);
             vkCreateSemaphore(device, &semInfo, nullptr, &renderFinishedSemaphores[i]);
-            vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]);
         }
+
+        VkSemaphoreTypeCreateInfo typeInfo{};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0;
+        semInfo.pNext = &typeInfo;
+        if (vkCreateSemaphore(device, &semInfo, nullptr, &frameTimeline) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create frame timeline semaphore");
+    }
+
+    // Only when profiling was asked for; a queue without timestamp support turns it off
+    void createTimestampQueries() {
+        if (options.gpuProfilePath.empty() && !options.gpuProfileHud) return;
+
+        uint32_t count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, nullptr);
+        std::vector<VkQueueFamilyProperties> families(count);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, families.data());
+        uint32_t validBits = families[queueFamilies.graphicsFamily.value()].timestampValidBits;
+        if (validBits == 0) {
+            std::cerr << "GPU profiling disabled: graphics queue has no timestamps" << std::endl;
+            return;
+        }
+        timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(physicalDevice, &props);
+        timestampPeriod = props.limits.timestampPeriod;
+
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = GPU_QUERIES_PER_FRAME * MAX_FRAMES_IN_FLIGHT;
+        if (vkCreateQueryPool(device, &poolInfo, nullptr, &timestampPool) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create timestamp query pool");
+
+        if (!options.gpuProfilePath.empty()) {
+            gpuProfileCsv.open(options.gpuProfilePath, std::ios::trunc);
+            if (!gpuProfileCsv)
+                throw std::runtime_error("Failed to open GPU profile " + options.gpuProfilePath);
+            gpuProfileCsv << "frame";
+            for (const char* name : GPU_SECTION_NAMES) gpuProfileCsv << ',' << name << "_ms";
+            gpuProfileCsv << ",total_ms\n";
+        }
+    }
+
+    void createUploadObjects() {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = uploadFamily();
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create transfer command pool");
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = transferCommandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &uploadCmd) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate upload command buffer");
+
+        VkSemaphoreCreateInfo semInfo{};
+        semInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        vkCreateSemaphore(device, &semInfo, nullptr, &uploadSemaphore);
+        vkCreateFence(device, &fenceInfo, nullptr, &uploadFence);
     }
 
     void generateStars() {
@@ -707,7 +2711,7 @@ private:
         std::uniform_real_distribution<float> xDist(0.0f, WORLD_WIDTH);
         std::uniform_real_distribution<float> yDist(5.0f, WORLD_HEIGHT);
         std::uniform_real_distribution<float> brightDist(0.2f, 1.0f);
-        std::uniform_real_distribution<float> sizeDist(1.0f, 3.0f);
+        std::uniform_real_distribution<float> sizeDist(1.0f, MAX_STAR_SIZE);
 
         for (int i = 0; i < 300; i++) {
             stars.push_back({
@@ -716,15 +2720,18 @@ private:
                 sizeDist(rng)
             });
         }
+        // Sorted along x so the culling buckets are contiguous
+        std::sort(stars.begin(), stars.end(),
+                  [](const StarVertex& a, const StarVertex& b) { return a.pos.x < b.pos.x; });
     }
 
     void createStarsGeometry() {
         starsVertexCount = static_cast<uint32_t>(stars.size());
+        starBuckets = CullBuckets::build(stars.size(), 0.0f, WORLD_WIDTH, CULL_BUCKET_WIDTH,
+                                         [&](size_t i) { return stars[i].pos.x; });
         VkDeviceSize bufSize = sizeof(StarVertex) * stars.size();
-        createBuffer(bufSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                     starsVertexBuffer, starsVertexMemory);
-        uploadBuffer(starsVertexBuffer, starsVertexMemory, stars.data(), bufSize);
+        createStaticBuffer(stars.data(), bufSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                           starsVertexBuffer, starsVertexMemory);
     }
 
     void generateTerrain() {
@@ -769,16 +2776,16 @@ private:
     void createTerrainGeometry() {
         std::vector<TerrainVertex> verts;
         for (const auto& pt : terrainPoints) {
-            verts.push_back({{pt.x, pt.y}});   // surface
-            verts.push_back({{pt.x, 0.0f}});   // bottom
+            verts.push_back(quantizeTerrainVertex({pt.x, pt.y}));   // surface
+            verts.push_back(quantizeTerrainVertex({pt.x, 0.0f}));   // bottom
         }
 
         terrainVertexCount = static_cast<uint32_t>(verts.size());
+        terrainBuckets = CullBuckets::build(terrainPoints.size(), 0.0f, WORLD_WIDTH, CULL_BUCKET_WIDTH,
+                                            [&](size_t i) { return terrainPoints[i].x; });
         VkDeviceSize bufSize = sizeof(TerrainVertex) * verts.size();
-        createBuffer(bufSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                     terrainVertexBuffer, terrainVertexMemory);
-        uploadBuffer(terrainVertexBuffer, terrainVertexMemory, verts.data(), bufSize);
+        createStaticBuffer(verts.data(), bufSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                           terrainVertexBuffer, terrainVertexMemory);
     }
 
     void createLanderGeometry() {
@@ -835,10 +2842,8 @@ private:
 
         landerVertexCount = static_cast<uint32_t>(verts.size());
         VkDeviceSize bufSize = sizeof(Vertex2D) * verts.size();
-        createBuffer(bufSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                     landerVertexBuffer, landerVertexMemory);
-        uploadBuffer(landerVertexBuffer, landerVertexMemory, verts.data(), bufSize);
+        createStaticBuffer(verts.data(), bufSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                           landerVertexBuffer, landerVertexMemory);
     }
     
     void createLandingPadGeometry() {
@@ -864,16 +2869,71 @@ private:
 
         landingPadVertexCount = static_cast<uint32_t>(verts.size());
         VkDeviceSize bufSize = sizeof(Vertex2D) * verts.size();
-        createBuffer(bufSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                     landingPadVertexBuffer, landingPadVertexMemory);
-        uploadBuffer(landingPadVertexBuffer, landingPadVertexMemory, verts.data(), bufSize);
+        createStaticBuffer(verts.data(), bufSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                           landingPadVertexBuffer, landingPadVertexMemory);
+    }
+
+    void createFontAtlas() {
+        std::vector<uint8_t> pixels = buildFontAtlas();
+        createStaticImage(pixels.data(), FONT_ATLAS_WIDTH, FONT_ATLAS_HEIGHT, VK_FORMAT_R8_UNORM, 1,
+                          fontAtlasImage, fontAtlasMemory);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = fontAtlasImage;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R8_UNORM;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(device, &viewInfo, nullptr, &fontAtlasView) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create font atlas view");
+
+        // Bilinear filtering is what makes the distance field scale smoothly
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.maxLod = 0.0f;
+        if (vkCreateSampler(device, &samplerInfo, nullptr, &fontSampler) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create font sampler");
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &hudSetLayout;
+        if (vkAllocateDescriptorSets(device, &allocInfo, &hudDescriptorSet) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate HUD descriptor set");
+
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.sampler = fontSampler;
+        imageInfo.imageView = fontAtlasView;
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = hudDescriptorSet;
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &imageInfo;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
     }
 
     void resetLander() {
         lander = Lander{};
-        particleAccumulator = 0.0f;
-        for (auto& p : particles) p.active = false;       
+        particleCount = 0;
+        for (auto& e : emitters) {
+            e.active = false;
+            e.burst = 0;
+            e.accumulator = 0.0f;
+        }
+        lastEmitterState = SimState::Flying;
+        resetFleet();
         cameraPos = lander.pos;
         cameraZoom = 1.0f;       
     }
@@ -930,18 +2990,58 @@ private:
     // updatePhysics function
     // ------------------------------------------------------------------------------------
 
-    void updatePhysics(float dt) {
+    // Producer side of inputQueue, called from the key callback. A control changes only
+    // when its first key goes down or its last key comes up.
+    void queueKey(int key, bool pressed) {
+        Control control;
+        switch (key) {
+        case GLFW_KEY_UP: case GLFW_KEY_W: control = Control::Thrust; break;
+        case GLFW_KEY_LEFT: case GLFW_KEY_A: control = Control::Left; break;
+        case GLFW_KEY_RIGHT: case GLFW_KEY_D: control = Control::Right; break;
+        default: return;
+        }
+        int& down = controlKeysDown[static_cast<size_t>(control)];
+        bool wasHeld = down > 0;
+        down = std::max(0, down + (pressed ? 1 : -1));
+        if ((down > 0) == wasHeld) return;
+        InputEvent event{secondsSinceStart(std::chrono::steady_clock::now()), control, down > 0};
+        if (!inputQueue.push(event)) droppedInputEvents++;
+    }
+
+    // Runs the lander's fixed ticks up to `until` seconds on the sim clock. Each queued
+    // transition lands in the tick containing its timestamp, and a control counts for a
+    // tick if it was held at the start or pressed during it. So a tap shorter than a frame
+    // still fires, and the same key timing flies the same at 30 or 300 FPS.
+    void stepLander(double until) {
+        PROFILE_SCOPE("stepLander");
+        auto target = static_cast<uint64_t>(until * SIM_TICK_RATE + 1e-6);
+        if (target > simTicks + MAX_CATCHUP_TICKS) simTicks = target - MAX_CATCHUP_TICKS;
+
+        for (; simTicks < target; simTicks++) {
+            double tickEnd = double(simTicks + 1) / SIM_TICK_RATE;
+            std::array<bool, CONTROL_COUNT> active = controlHeld;
+            while (const InputEvent* event = inputQueue.peek()) {
+                if (event->time >= tickEnd) break;
+                auto c = static_cast<size_t>(event->control);
+                controlHeld[c] = event->pressed;
+                active[c] = active[c] || event->pressed;
+                inputQueue.pop();
+            }
+            updatePhysics(SIM_TICK, active);
+        }
+    }
+
+    void updatePhysics(float dt, const std::array<bool, CONTROL_COUNT>& controls) {
         if (lander.state != SimState::Flying) return;
 
-        bool thrustInput = glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS ||
-                           glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
-        bool leftInput = glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS ||
-                         glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
-        bool rightInput = glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS ||
-                          glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+        bool thrustInput = controls[static_cast<size_t>(Control::Thrust)];
+        bool leftInput = controls[static_cast<size_t>(Control::Left)];
+        bool rightInput = controls[static_cast<size_t>(Control::Right)];
 
         if (leftInput) lander.angle -= ROTATION_SPEED * dt;
         if (rightInput) lander.angle += ROTATION_SPEED * dt;
+        lander.rcsLeft = leftInput;
+        lander.rcsRight = rightInput;
 
         lander.vel.y -= LUNAR_GRAVITY * dt;
 
@@ -968,6 +3068,7 @@ private:
             lander.pos.y = terrainH + 0.5f;
 
             float speed = glm::length(lander.vel);
+            lander.touchdownSpeed = speed;
             float absAngle = std::abs(std::fmod(lander.angle, glm::two_pi<float>()));
             if (absAngle > glm::pi<float>()) absAngle = glm::two_pi<float>() - absAngle;
 
@@ -978,6 +3079,7 @@ private:
             if (speed < SAFE_LANDING_VEL && absAngle < SAFE_LANDING_ANGLE && onPad) {
                 lander.state = SimState::Landed;
                 lander.vel = {0.0f, 0.0f};
+                lander.outcome = "PRESS R TO FLY AGAIN";
                 std::cout << "*** SUCCESSFUL LANDING! ***" << std::endl;
                 std::cout << "    Speed: " << speed << " m/s  |  Angle: "
                           << glm::degrees(absAngle) << " deg  |  Fuel: "
@@ -985,17 +3087,77 @@ private:
             } else {
                 lander.state = SimState::Crashed;
                 lander.vel = {0.0f, 0.0f};
-                if (!onPad)
+                if (!onPad) {
+                    lander.outcome = "MISSED THE PAD";
                     std::cout << "CRASH — Missed the landing pad!" << std::endl;
-                else if (speed >= SAFE_LANDING_VEL)
+                } else if (speed >= SAFE_LANDING_VEL) {
+                    lander.outcome = "TOO FAST";
                     std::cout << "CRASH — Too fast! (" << speed << " m/s)" << std::endl;
-                else
+                } else {
+                    lander.outcome = "BAD ANGLE";
                     std::cout << "CRASH — Bad angle! (" << glm::degrees(absAngle) << " deg)" << std::endl;
+                }
                 std::cout << "    Press R to retry." << std::endl;
             }
         }
     }
 
+    // ------------------------------------------------------------------------------------
+    // updateFleet function
+    // ------------------------------------------------------------------------------------
+
+    // Scatters the fleet across the upper sky with throttles around hover, so a batch
+    // run ends in a mix of landings and crashes
+    void resetFleet() {
+        FastRng fleetRng(static_cast<uint32_t>(rng()));
+        float hover = LUNAR_GRAVITY / THRUST_POWER;
+        for (auto& f : fleet) {
+            f.pos = {fleetRng.uniform(0.0f, WORLD_WIDTH), fleetRng.uniform(0.5f, 0.95f) * WORLD_HEIGHT};
+            f.vel = {fleetRng.uniform(-1.0f, 1.0f), fleetRng.uniform(-0.5f, 0.5f)};
+            f.angle = fleetRng.uniform(-0.2f, 0.2f);
+            f.spin = fleetRng.uniform(-0.1f, 0.1f);
+            f.throttle = hover * fleetRng.uniform(0.6f, 1.05f);
+            f.fuel = INITIAL_FUEL;
+            f.state = SimState::Flying;
+        }
+    }
+
+    // Same integration and touchdown rules as updatePhysics, in parallel blocks
+    void updateFleet(float dt) {
+        PROFILE_SCOPE("updateFleet");
+        float padLeft = landingPadX - LANDING_PAD_WIDTH / 2.0f;
+        float padRight = landingPadX + LANDING_PAD_WIDTH / 2.0f;
+        workers.parallelFor(fleet.size(), FLEET_BLOCK_SIZE, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                FleetLander& f = fleet[i];
+                if (f.state != SimState::Flying) continue;
+
+                f.angle += f.spin * dt;
+                f.vel.y -= LUNAR_GRAVITY * dt;
+                if (f.fuel > 0.0f) {
+                    float thrust = f.throttle * THRUST_POWER;
+                    f.vel.x -= std::sin(f.angle) * thrust * dt;
+                    f.vel.y += std::cos(f.angle) * thrust * dt;
+                    f.fuel = std::max(f.fuel - FUEL_BURN_RATE * f.throttle * dt, 0.0f);
+                }
+                f.pos += f.vel * dt;
+                if (f.pos.x < 0) f.pos.x += WORLD_WIDTH;
+                if (f.pos.x > WORLD_WIDTH) f.pos.x -= WORLD_WIDTH;
+
+                float terrainH = getTerrainHeight(f.pos.x);
+                if (f.pos.y - 0.5f > terrainH) continue;
+
+                f.pos.y = terrainH + 0.5f;
+                float absAngle = std::abs(std::fmod(f.angle, glm::two_pi<float>()));
+                if (absAngle > glm::pi<float>()) absAngle = glm::two_pi<float>() - absAngle;
+                bool onPad = f.pos.x >= padLeft && f.pos.x <= padRight;
+                f.state = glm::length(f.vel) < SAFE_LANDING_VEL && absAngle < SAFE_LANDING_ANGLE && onPad
+                    ? SimState::Landed : SimState::Crashed;
+                f.vel = {0.0f, 0.0f};
+            }
+        });
+    }
+
     float getTerrainHeight(float x) const {
         if (terrainPoints.empty()) return 0.0f;
         float dx = WORLD_WIDTH / TERRAIN_SEGMENTS;
@@ -1006,86 +3168,364 @@ private:
         return glm::mix(terrainPoints[idx].y, terrainPoints[idx + 1].y, t);
     }
 
+    // Batched getTerrainHeight for particle blocks: same interpolation, loop-invariant setup hoisted
+    void sampleTerrainHeights(const float* xs, float* out, size_t count) const {
+        if (terrainPoints.empty()) {
+            std::fill(out, out + count, 0.0f);
+            return;
+        }
+        const float invDx = TERRAIN_SEGMENTS / WORLD_WIDTH;
+        const int last = static_cast<int>(terrainPoints.size()) - 2;
+        const glm::vec2* pts = terrainPoints.data();
+        for (size_t i = 0; i < count; i++) {
+            float f = xs[i] * invDx;
+            int idx = std::clamp(static_cast<int>(f), 0, last);
+            float t = std::clamp(f - static_cast<float>(idx), 0.0f, 1.0f);
+            out[i] = glm::mix(pts[idx].y, pts[idx + 1].y, t);
+        }
+    }
+
     // ------------------------------------------------------------------------------------
     // updateParticles function
     // ------------------------------------------------------------------------------------
     
     void updateParticles(float dt) {
-        std::uniform_real_distribution<float> angleDist(-0.4f, 0.4f);
-        std::uniform_real_distribution<float> speedDist(3.0f, 7.0f);
-        std::uniform_real_distribution<float> lifeDist(0.3f, PARTICLE_LIFETIME);
-        std::uniform_real_distribution<float> sizeDist(2.0f, 6.0f);
-
-        // Spawn new particles while thrusting
-        if (lander.thrusting && lander.state == SimState::Flying) {
-            particleAccumulator += PARTICLE_SPAWN_RATE * dt;
-            while (particleAccumulator >= 1.0f) {
-                particleAccumulator -= 1.0f;
-
-                // Find first inactive slot in the pool
-                for (auto& p : particles) {
-                    if (!p.active) {
-                        // Nozzle direction = lander angle + π (opposite of thrust)
-                        // Plus random spread for visual variety
-                        float nozzleAngle = lander.angle + glm::pi<float>() + angleDist(rng);
-                        float speed = speedDist(rng);
-
-                        // Spawn at nozzle position (0.25 units behind lander center)
-                        p.pos = lander.pos + glm::vec2(
-                            -std::sin(lander.angle) * (-0.25f),
-                             std::cos(lander.angle) * (-0.25f)
-                        );
-
-                        // Particle velocity = lander velocity + nozzle ejection
-                        p.vel = lander.vel + glm::vec2(
-                            -std::sin(nozzleAngle) * speed,
-                             std::cos(nozzleAngle) * speed
-                        );
-
-                        p.maxLife = lifeDist(rng);
-                        p.life = p.maxLife;
-                        p.size = sizeDist(rng);
-                        p.active = true;
-                        break;  // one particle per accumulator tick
+        PROFILE_SCOPE("updateParticles");
+        updateEmitters(dt);
+
+        // Group particles by cell, then let dust push on its neighbors. Compaction below keeps
+        // relative order, so the render upload also sees (nearly) cell-sorted particles.
+        sortParticlesByCell();
+        applyDustRepulsion(dt);
+
+        // Plume strength at the surface: 0 above DUST_TRIGGER_ALTITUDE, 1 at touchdown
+        float altitude = lander.pos.y - 0.5f - getTerrainHeight(lander.pos.x);
+        float dustStrength = 0.0f;
+        if (lander.state == SimState::Flying)
+            dustStrength = std::clamp(1.0f - altitude / DUST_TRIGGER_ALTITUDE, 0.0f, 1.0f);
+
+        // Age, move and collide in parallel; each block compacts its own survivors
+        size_t blockCount = (particleCount + PARTICLE_BLOCK_SIZE - 1) / PARTICLE_BLOCK_SIZE;
+        if (particleBlocks.size() < blockCount) particleBlocks.resize(blockCount);
+        uint32_t frameSeed = ++particleFrame * 0x9E3779B9u;
+
+        workers.parallelFor(particleCount, PARTICLE_BLOCK_SIZE, [&](size_t begin, size_t end) {
+            ParticleBlock& block = particleBlocks[begin / PARTICLE_BLOCK_SIZE];
+            FastRng blockRng(frameSeed ^ static_cast<uint32_t>(begin + 1));
+            updateParticleBlock(begin, end, dt, dustStrength, block, blockRng);
+        });
+
+        // Close the gaps between blocks, then append this frame's dust
+        size_t write = 0;
+        for (size_t b = 0; b < blockCount; b++) {
+            size_t begin = b * PARTICLE_BLOCK_SIZE;
+            size_t alive = particleBlocks[b].alive;
+            if (write != begin && alive > 0)
+                std::memmove(&particles[write], &particles[begin], alive * sizeof(Particle));
+            write += alive;
+        }
+        particleCount = write;
+
+        for (size_t b = 0; b < blockCount; b++) {
+            auto& spawned = particleBlocks[b].spawned;
+            size_t n = std::min(spawned.size(), MAX_PARTICLES - particleCount);
+            std::copy(spawned.begin(), spawned.begin() + n, particles.begin() + particleCount);
+            particleCount += n;
+        }
+    }
+
+    // Parallel counting sort of the live range by hash bucket, O(N + blocks * buckets):
+    // per-block histograms, per-bucket scan across blocks, global prefix sum, then scatter.
+    void sortParticlesByCell() {
+        PROFILE_SCOPE("sortParticlesByCell");
+        size_t count = particleCount;
+        size_t blockCount = (count + PARTICLE_BLOCK_SIZE - 1) / PARTICLE_BLOCK_SIZE;
+        if (blockCount == 0) {
+            std::fill(bucketStart.begin(), bucketStart.end(), 0);
+            return;
+        }
+        blockBucketOffsets.resize(blockCount * PARTICLE_HASH_BUCKETS);
+
+        // 1. Key every particle and histogram each block
+        workers.parallelFor(count, PARTICLE_BLOCK_SIZE, [&](size_t begin, size_t end) {
+            uint32_t* hist = &blockBucketOffsets[(begin / PARTICLE_BLOCK_SIZE) * PARTICLE_HASH_BUCKETS];
+            std::fill(hist, hist + PARTICLE_HASH_BUCKETS, 0);
+            for (size_t i = begin; i < end; i++) {
+                const glm::vec2& pos = particles[i].pos;
+                uint32_t key = particleCellHash(particleCell(pos.x), particleCell(pos.y));
+                particleKeys[i] = key;
+                hist[key]++;
+            }
+        });
+
+        // 2. For each bucket, turn block counts into offsets within the bucket
+        constexpr size_t BUCKETS_PER_JOB = 256;
+        workers.parallelFor(PARTICLE_HASH_BUCKETS, BUCKETS_PER_JOB, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                uint32_t running = 0;
+                for (size_t b = 0; b < blockCount; b++) {
+                    uint32_t& slot = blockBucketOffsets[b * PARTICLE_HASH_BUCKETS + k];
+                    uint32_t n = slot;
+                    slot = running;
+                    running += n;
+                }
+                bucketStart[k + 1] = running;   // bucket size for now
+            }
+        });
+
+        // 3. Bucket sizes -> bucket starts
+        bucketStart[0] = 0;
+        for (uint32_t k = 0; k < PARTICLE_HASH_BUCKETS; k++)
+            bucketStart[k + 1] += bucketStart[k];
+
+        // 4. Scatter; each block owns a disjoint slice of every bucket
+        workers.parallelFor(count, PARTICLE_BLOCK_SIZE, [&](size_t begin, size_t end) {
+            uint32_t* cursor = &blockBucketOffsets[(begin / PARTICLE_BLOCK_SIZE) * PARTICLE_HASH_BUCKETS];
+            for (size_t i = begin; i < end; i++) {
+                uint32_t key = particleKeys[i];
+                sortedParticles[bucketStart[key] + cursor[key]++] = particles[i];
+            }
+        });
+        particles.swap(sortedParticles);
+    }
+
+    // Simple density-driven spreading for airborne dust, using the cell-sorted pool
+    void applyDustRepulsion(float dt) {
+        const float radius2 = DUST_INTERACTION_RADIUS * DUST_INTERACTION_RADIUS;
+        workers.parallelFor(particleCount, PARTICLE_BLOCK_SIZE, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                Particle& p = particles[i];
+                if (p.kind != ParticleKind::Dust) continue;
+
+                int32_t cx = particleCell(p.pos.x);
+                int32_t cy = particleCell(p.pos.y);
+                uint32_t visited[9];
+                int visitedCount = 0;
+                int neighbors = 0;
+                glm::vec2 push{0.0f, 0.0f};
+
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        uint32_t key = particleCellHash(cx + dx, cy + dy);
+                        if (std::find(visited, visited + visitedCount, key) != visited + visitedCount)
+                            continue;   // two neighbor cells hashed to the same bucket
+                        visited[visitedCount++] = key;
+
+                        // Only pos and kind of neighbors are read; other jobs write vel only
+                        for (uint32_t j = bucketStart[key]; j < bucketStart[key + 1]; j++) {
+                            if (j == i || particles[j].kind != ParticleKind::Dust) continue;
+                            glm::vec2 d = p.pos - particles[j].pos;
+                            float dist2 = glm::dot(d, d);
+                            if (dist2 >= radius2 || dist2 < 1e-12f) continue;
+                            float dist = std::sqrt(dist2);
+                            push += d * ((1.0f - dist / DUST_INTERACTION_RADIUS) / dist);
+                            if (++neighbors >= DUST_MAX_NEIGHBORS) break;
+                        }
+                        if (neighbors >= DUST_MAX_NEIGHBORS) break;
                     }
+                    if (neighbors >= DUST_MAX_NEIGHBORS) break;
                 }
+                p.vel += push * (DUST_REPULSION * dt);
             }
+        });
+    }
+
+    void initEmitters() {
+        Emitter& engine = emitter(EmitterId::MainEngine);
+        engine.rate = PARTICLE_SPAWN_RATE;
+        engine.params.spread = 0.4f;
+        engine.params.speedMin = 3.0f;  engine.params.speedMax = 7.0f;
+        engine.params.lifeMin = 0.3f;   engine.params.lifeMax = PARTICLE_LIFETIME;
+        engine.params.sizeMin = 2.0f;   engine.params.sizeMax = 6.0f;
+
+        for (EmitterId id : {EmitterId::RcsLeft, EmitterId::RcsRight}) {
+            Emitter& rcs = emitter(id);
+            rcs.rate = RCS_SPAWN_RATE;
+            rcs.params.spread = 0.15f;
+            rcs.params.speedMin = 2.0f;  rcs.params.speedMax = 4.0f;
+            rcs.params.lifeMin = 0.1f;   rcs.params.lifeMax = 0.25f;
+            rcs.params.sizeMin = 1.5f;   rcs.params.sizeMax = 3.0f;
         }
 
-        // Age and move existing particles
-        for (auto& p : particles) {
-            if (!p.active) continue;
-            p.life -= dt;
-            if (p.life <= 0.0f) {
-                p.active = false;
-                continue;
+        Emitter& debris = emitter(EmitterId::CrashDebris);
+        debris.params.radius = 0.4f;
+        debris.params.spread = glm::pi<float>();
+        debris.params.speedMin = 2.0f;  debris.params.speedMax = 9.0f;
+        debris.params.lifeMin = 1.5f;   debris.params.lifeMax = 3.5f;
+        debris.params.sizeMin = 2.0f;   debris.params.sizeMax = 4.0f;
+        debris.params.kind = ParticleKind::Debris;
+
+        Emitter& dust = emitter(EmitterId::TouchdownDust);
+        dust.params.radius = 0.5f;
+        dust.params.spread = 1.4f;
+        dust.params.speedMin = 0.5f;    dust.params.speedMax = 3.0f;
+        dust.params.lifeMin = DUST_LIFETIME * 0.5f;  dust.params.lifeMax = DUST_LIFETIME;
+        dust.params.sizeMin = 1.5f;     dust.params.sizeMax = 3.5f;
+        dust.params.kind = ParticleKind::Dust;
+    }
+
+    Emitter& emitter(EmitterId id) { return emitters[static_cast<size_t>(id)]; }
+
+    void updateEmitters(float dt) {
+        glm::vec2 up{-std::sin(lander.angle), std::cos(lander.angle)};
+        glm::vec2 right{std::cos(lander.angle), std::sin(lander.angle)};
+        bool flying = lander.state == SimState::Flying;
+
+        // Continuous emitters follow the lander
+        Emitter& engine = emitter(EmitterId::MainEngine);
+        engine.active = flying && lander.thrusting;
+        engine.params.pos = lander.pos - up * 0.25f;      // nozzle, 0.25 units behind center
+        engine.params.vel = lander.vel;
+        engine.params.direction = lander.angle + glm::pi<float>();
+
+        Emitter& rcsLeft = emitter(EmitterId::RcsLeft);
+        rcsLeft.active = flying && lander.rcsLeft;
+        rcsLeft.params.pos = lander.pos + up * 0.4f + right * 0.3f;
+        rcsLeft.params.vel = lander.vel;
+        rcsLeft.params.direction = lander.angle - glm::half_pi<float>();
+
+        Emitter& rcsRight = emitter(EmitterId::RcsRight);
+        rcsRight.active = flying && lander.rcsRight;
+        rcsRight.params.pos = lander.pos + up * 0.4f - right * 0.3f;
+        rcsRight.params.vel = lander.vel;
+        rcsRight.params.direction = lander.angle + glm::half_pi<float>();
+
+        // One-shot bursts on the frame the lander touches down
+        if (lastEmitterState == SimState::Flying && !flying) {
+            Emitter& dust = emitter(EmitterId::TouchdownDust);
+            dust.params.pos = {lander.pos.x, getTerrainHeight(lander.pos.x)};
+            dust.burst += static_cast<size_t>(TOUCHDOWN_DUST_PER_SPEED * (lander.touchdownSpeed + 0.5f));
+
+            if (lander.state == SimState::Crashed) {
+                Emitter& debris = emitter(EmitterId::CrashDebris);
+                debris.params.pos = lander.pos;
+                debris.burst += CRASH_DEBRIS_COUNT;
             }
-            p.vel.y -= LUNAR_GRAVITY * 0.3f * dt;  // light gravity droop
+        }
+        lastEmitterState = lander.state;
+
+        for (auto& e : emitters) {
+            size_t count = e.burst;
+            e.burst = 0;
+            if (e.active) {
+                e.accumulator += e.rate * dt;
+                size_t n = static_cast<size_t>(e.accumulator);
+                e.accumulator -= static_cast<float>(n);
+                count += n;
+            } else {
+                e.accumulator = 0.0f;
+            }
+            if (count > 0) spawnParticles(count, e.params);
+        }
+    }
+
+    // Batch spawn: claims `count` contiguous slots at the end of the live range and fills
+    // them in parallel, so a crash burst costs the same per particle as a single puff.
+    size_t spawnParticles(size_t count, const SpawnParams& params) {
+        count = std::min(count, MAX_PARTICLES - particleCount);
+        if (count == 0) return 0;
+
+        Particle* first = particles.data() + particleCount;
+        particleCount += count;
+
+        uint32_t seed = static_cast<uint32_t>(rng());
+        workers.parallelFor(count, PARTICLE_BLOCK_SIZE, [&](size_t begin, size_t end) {
+            FastRng batchRng(seed + static_cast<uint32_t>(begin) * 0x9E3779B9u);
+            for (size_t i = begin; i < end; i++) {
+                Particle& p = first[i];
+                float angle = params.direction + batchRng.uniform(-params.spread, params.spread);
+                float speed = batchRng.uniform(params.speedMin, params.speedMax);
+                glm::vec2 jitter{batchRng.uniform(-1.0f, 1.0f), batchRng.uniform(-1.0f, 1.0f)};
+
+                p.pos = params.pos + jitter * params.radius;
+                p.vel = params.vel + glm::vec2(-std::sin(angle), std::cos(angle)) * speed;
+                p.maxLife = batchRng.uniform(params.lifeMin, params.lifeMax);
+                p.life = p.maxLife;
+                p.size = batchRng.uniform(params.sizeMin, params.sizeMax);
+                p.kind = params.kind;
+            }
+        });
+        return count;
+    }
+
+    void updateParticleBlock(size_t begin, size_t end, float dt, float dustStrength,
+                             ParticleBlock& block, FastRng& blockRng) {
+        size_t n = end - begin;
+        block.xs.resize(n);
+        block.heights.resize(n);
+        block.spawned.clear();
+
+        // Integrate first so the whole block shares one batched height lookup
+        for (size_t i = 0; i < n; i++) {
+            Particle& p = particles[begin + i];
+            p.life -= dt;
+            float gravity = p.kind == ParticleKind::Exhaust
+                ? LUNAR_GRAVITY * 0.3f         // light gravity droop
+                : LUNAR_GRAVITY;               // ballistic, no atmosphere to hold it up
+            p.vel.y -= gravity * dt;
             p.pos += p.vel * dt;
+            block.xs[i] = p.pos.x;
         }
-    }    
-    
+        sampleTerrainHeights(block.xs.data(), block.heights.data(), n);
+
+        size_t alive = 0;
+        for (size_t i = 0; i < n; i++) {
+            Particle p = particles[begin + i];
+            if (p.life <= 0.0f) continue;
+
+            float ground = block.heights[i];
+            if (p.pos.y <= ground) {
+                float impactSpeed = -p.vel.y;
+                p.pos.y = ground;
+
+                if (p.kind == ParticleKind::Exhaust) {
+                    if (dustStrength > 0.0f && impactSpeed > DUST_MIN_IMPACT_SPEED)
+                        kickUpDust(p, dustStrength, block.spawned, blockRng);
+                    p.vel.y = std::max(impactSpeed, 0.0f) * EXHAUST_RESTITUTION;
+                } else {
+                    p.vel.y = std::max(impactSpeed, 0.0f) * DUST_RESTITUTION;
+                    p.vel.x *= DUST_FRICTION;
+                    if (p.vel.y < DUST_SETTLE_SPEED) p.vel = {0.0f, 0.0f};  // settled
+                }
+            }
+            particles[begin + alive++] = p;
+        }
+        block.alive = alive;
+    }
+
+    void kickUpDust(const Particle& exhaust, float strength,
+                    std::vector<Particle>& out, FastRng& blockRng) const {
+        // Stochastic rounding keeps the average ejecta count smooth as strength ramps
+        int count = static_cast<int>(DUST_PER_IMPACT * strength + blockRng.uniform());
+
+        // Ejecta sprays outward from under the lander at a shallow angle
+        float dir = exhaust.pos.x >= lander.pos.x ? 1.0f : -1.0f;
+        for (int i = 0; i < count; i++) {
+            float angle = blockRng.uniform(0.08f, 0.5f);
+            float speed = blockRng.uniform(1.5f, 5.0f) * (0.5f + strength);
+
+            Particle d;
+            d.pos = exhaust.pos + glm::vec2(0.0f, 0.02f);
+            d.vel = {dir * std::cos(angle) * speed, std::sin(angle) * speed};
+            d.maxLife = blockRng.uniform(DUST_LIFETIME * 0.5f, DUST_LIFETIME);
+            d.life = d.maxLife;
+            d.size = blockRng.uniform(1.5f, 3.5f);
+            d.kind = ParticleKind::Dust;
+            out.push_back(d);
+        }
+    }
+
     // ------------------------------------------------------------------------------------
     // buildHud function
     // ------------------------------------------------------------------------------------
 
-    HudRenderData buildHud() {
-        HudRenderData hud;
-
+    void buildHud(HudBatch& hud) {
+        PROFILE_SCOPE("buildHud");
         float sw = static_cast<float>(swapchainExtent.width);
         float sh = static_cast<float>(swapchainExtent.height);
 
-        // Helper: append a colored quad to the HUD batch
         auto addBar = [&](float x, float y, float w, float h, glm::vec4 color) {
-            uint32_t offset = static_cast<uint32_t>(hud.vertices.size());
-            hud.vertices.push_back({x, y});
-            hud.vertices.push_back({x + w, y});
-            hud.vertices.push_back({x + w, y + h});
-            hud.vertices.push_back({x, y});
-            hud.vertices.push_back({x + w, y + h});
-            hud.vertices.push_back({x, y + h});
-            hud.bars.push_back({offset, 6});
-            hud.barColors.push_back(color);
+            hud.addQuad(x, y, w, h, color);
         };
 
         float barX = 20.0f, barY = sh - 40.0f, barW = 200.0f, barH = 20.0f;
@@ -1113,14 +3553,50 @@ private:
         addBar(barX, barY - 60.0f, barW, barH, {0.2f, 0.2f, 0.2f, 0.7f});
         addBar(barX, barY - 60.0f, barW * altFrac, barH, {0.3f, 0.5f, 0.9f, 0.9f});
 
+        // Numeric readouts to the right of each bar
+        const glm::vec4 textColor(0.9f, 0.9f, 0.9f, 1.0f);
+        const float textSize = 14.0f;
+        float textX = barX + barW + 10.0f;
+        float textDy = (barH - textSize) / 2.0f;
+        char text[32];
+        std::snprintf(text, sizeof(text), "FUEL %d%%", static_cast<int>(fuelFrac * 100.0f + 0.5f));
+        hud.addText(textX, barY + textDy, textSize, text, textColor);
+        std::snprintf(text, sizeof(text), "SPD %.2f M/S", speed);
+        hud.addText(textX, barY - 30.0f + textDy, textSize, text, textColor);
+        std::snprintf(text, sizeof(text), "ALT %.1f M", std::max(altitude, 0.0f));
+        hud.addText(textX, barY - 60.0f + textDy, textSize, text, textColor);
+
+        // GPU section times, top left (--gpu-hud)
+        if (options.gpuProfileHud && timestampPool) {
+            const char* labels[GPU_SECTION_COUNT] = {"STARS", "TERRAIN", "PAD", "PARTICLES", "LANDERS", "HUD"};
+            float y = 20.0f;
+            float total = 0.0f;
+            for (size_t i = 0; i < GPU_SECTION_COUNT; i++) {
+                std::snprintf(text, sizeof(text), "%-9s %.3f MS", labels[i], gpuSectionMs[i]);
+                hud.addText(20.0f, y, 12.0f, text, textColor);
+                total += gpuSectionMs[i];
+                y += 18.0f;
+            }
+            std::snprintf(text, sizeof(text), "GPU       %.3f MS", total);
+            hud.addText(20.0f, y, 12.0f, text, textColor);
+        }
+
         // State indicator (centered banner)
+        const char* title = nullptr;
         if (lander.state == SimState::Landed) {
-            addBar(sw / 2 - 100, sh / 2 - 20, 200, 40, {0.1f, 0.7f, 0.2f, 0.8f});
+            addBar(sw / 2 - 150, sh / 2 - 30, 300, 60, {0.1f, 0.7f, 0.2f, 0.8f});
+            title = "LANDED";
         } else if (lander.state == SimState::Crashed) {
-            addBar(sw / 2 - 100, sh / 2 - 20, 200, 40, {0.8f, 0.1f, 0.1f, 0.8f});
+            addBar(sw / 2 - 150, sh / 2 - 30, 300, 60, {0.8f, 0.1f, 0.1f, 0.8f});
+            title = "CRASHED";
+        }
+        if (title) {
+            auto centered = [&](const char* str, float size) {
+                return sw / 2 - (std::strlen(str) * HudBatch::textAdvance(size) - size / FONT_GLYPH_ROWS) / 2;
+            };
+            hud.addText(centered(title, 22.0f), sh / 2 - 22, 22.0f, title, textColor);
+            hud.addText(centered(lander.outcome, 12.0f), sh / 2 + 8, 12.0f, lander.outcome, textColor);
         }
-
-        return hud;
     }
 
     // ------------------------------------------------------------------------------------
@@ -1128,6 +3604,7 @@ private:
     // ------------------------------------------------------------------------------------
 
     void updateCamera(float /*dt*/) {
+        PROFILE_SCOPE("updateCamera");
         float targetZoom = 1.0f;
         float altitude = lander.pos.y - getTerrainHeight(lander.pos.x);
         if (altitude < 5.0f)
@@ -1151,16 +3628,218 @@ private:
         return glm::ortho(left, right, top, bottom, -1.0f, 1.0f); // top/bottom swapped for Vulkan Y-down
     }
 
+    // ------------------------------------------------------------------------------------
+    // runSpriteBenchmark function
+    // ------------------------------------------------------------------------------------
+
+    // Renders a synthetic particle field through both sprite paths. Many 1 px sprites
+    // measure vertex/primitive throughput, a few large ones measure fill rate.
+    void runSpriteBenchmark() {
+        struct BenchCase {
+            const char* name;
+            size_t count;
+            float size;      // pixels
+        };
+        const BenchCase cases[] = {
+            {"vertex", MAX_PARTICLES, 1.0f},
+            {"fill", 4096, 48.0f},
+        };
+        constexpr int WARMUP_FRAMES = 10;
+        constexpr int BENCH_FRAMES = 200;
+
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(physicalDevice, &props);
+        std::cout << "Sprite benchmark, " << swapchainExtent.width << "x" << swapchainExtent.height
+                  << ", pointSizeRange max " << props.limits.pointSizeRange[1] << " px" << std::endl;
+        std::cout << "mode    case     sprites   ms/frame  Msprites/s  Mpixels/s" << std::endl;
+
+        SpriteMode savedMode = options.spriteMode;
+        for (SpriteMode mode : {SpriteMode::Points, SpriteMode::Quads}) {
+            options.spriteMode = mode;
+            invalidateStaticPasses();
+            for (const auto& bench : cases) {
+                fillBenchmarkParticles(bench.count, bench.size);
+
+                for (int i = 0; i < WARMUP_FRAMES; i++) drawFrame();
+                vkDeviceWaitIdle(device);
+
+                auto start = std::chrono::high_resolution_clock::now();
+                for (int i = 0; i < BENCH_FRAMES; i++) {
+                    glfwPollEvents();
+                    drawFrame();
+                }
+                vkDeviceWaitIdle(device);
+                double seconds = std::chrono::duration<double>(
+                    std::chrono::high_resolution_clock::now() - start).count();
+
+                // Points get clamped by the device, so count the size actually rasterized
+                float drawnSize = bench.size;
+                if (mode == SpriteMode::Points)
+                    drawnSize = std::min(drawnSize, props.limits.pointSizeRange[1]);
+                double sprites = static_cast<double>(bench.count) * BENCH_FRAMES;
+                double pixels = sprites * drawnSize * drawnSize;
+
+                std::printf("%-7s %-7s %8zu %10.3f %11.2f %10.1f\n",
+                    mode == SpriteMode::Points ? "points" : "quads", bench.name, bench.count,
+                    seconds * 1000.0 / BENCH_FRAMES, sprites / seconds / 1e6, pixels / seconds / 1e6);
+            }
+        }
+        options.spriteMode = savedMode;
+        invalidateStaticPasses();
+        particleCount = 0;
+    }
+
+    void fillBenchmarkParticles(size_t count, float size) {
+        std::uniform_real_distribution<float> xDist(cameraPos.x - WORLD_WIDTH / 2.0f, cameraPos.x + WORLD_WIDTH / 2.0f);
+        std::uniform_real_distribution<float> yDist(cameraPos.y - WORLD_HEIGHT / 2.0f, cameraPos.y + WORLD_HEIGHT / 2.0f);
+        particleCount = std::min(count, MAX_PARTICLES);
+        for (size_t i = 0; i < particleCount; i++) {
+            Particle& p = particles[i];
+            p.pos = {xDist(rng), yDist(rng)};
+            p.vel = {0.0f, 0.0f};
+            p.maxLife = p.life = 1.0f;   // full life -> shader draws at full size
+            p.size = size;
+            p.kind = ParticleKind::Exhaust;
+        }
+    }
+
+    // ------------------------------------------------------------------------------------
+    // runParticleSortBenchmark function
+    // ------------------------------------------------------------------------------------
+
+    // Times sortParticlesByCell() on PARTICLE_SORT_BENCH_COUNT particles, spread over the
+    // world and packed into a dust plume over the pad, where few buckets take most of them
+    void runParticleSortBenchmark() {
+        constexpr int WARMUP_RUNS = 5;
+        constexpr int BENCH_RUNS = 100;
+
+        particles.resize(PARTICLE_SORT_BENCH_COUNT);
+        sortedParticles.resize(PARTICLE_SORT_BENCH_COUNT);
+        particleKeys.resize(PARTICLE_SORT_BENCH_COUNT);
+        bucketStart.assign(PARTICLE_HASH_BUCKETS + 1, 0);
+
+        std::cout << "Particle sort benchmark, " << workers.size() << " threads" << std::endl;
+        std::cout << "case     particles    avg ms    min ms" << std::endl;
+
+        FastRng benchRng(0x5EED);
+        for (bool plume : {false, true}) {
+            particleCount = PARTICLE_SORT_BENCH_COUNT;
+            for (auto& p : particles) {
+                p = Particle{};
+                if (plume)
+                    p.pos = {LANDING_PAD_X + benchRng.uniform(-3.0f, 3.0f), GROUND_HEIGHT + benchRng.uniform(0.0f, 1.5f)};
+                else
+                    p.pos = {benchRng.uniform(0.0f, WORLD_WIDTH), benchRng.uniform(0.0f, WORLD_HEIGHT)};
+                p.maxLife = p.life = 1.0f;
+                p.size = 1.0f;
+                p.kind = ParticleKind::Dust;
+            }
+
+            for (int i = 0; i < WARMUP_RUNS; i++) sortParticlesByCell();
+            double totalMs = 0.0, bestMs = 1e9;
+            for (int i = 0; i < BENCH_RUNS; i++) {
+                auto start = std::chrono::high_resolution_clock::now();
+                sortParticlesByCell();
+                double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::high_resolution_clock::now() - start).count();
+                totalMs += ms;
+                bestMs = std::min(bestMs, ms);
+            }
+            std::printf("%-8s %9zu %9.3f %9.3f\n", plume ? "plume" : "uniform",
+                        particleCount, totalMs / BENCH_RUNS, bestMs);
+        }
+        particleCount = 0;
+    }
+
+    // ------------------------------------------------------------------------------------
+    // runTerrainBenchmark function
+    // ------------------------------------------------------------------------------------
+
+    // Draws one very dense terrain strip from each memory type. The triangles are thin,
+    // so the frame cost is dominated by vertex fetch rather than fill.
+    void runTerrainBenchmark() {
+        constexpr uint32_t SEGMENTS = 1u << 21;
+        constexpr int WARMUP_FRAMES = 10;
+        constexpr int BENCH_FRAMES = 200;
+
+        std::vector<TerrainVertex> verts;
+        verts.reserve(2 * (SEGMENTS + 1));
+        for (uint32_t i = 0; i <= SEGMENTS; i++) {
+            float x = WORLD_WIDTH * static_cast<float>(i) / SEGMENTS;
+            float h = 2.0f + 1.5f * std::sin(x * 0.3f) + 0.05f * std::sin(x * 40.0f);
+            verts.push_back(quantizeTerrainVertex({x, h}));
+            verts.push_back(quantizeTerrainVertex({x, 0.0f}));
+        }
+        VkDeviceSize bufSize = sizeof(TerrainVertex) * verts.size();
+
+        std::cout << "Terrain benchmark, " << verts.size() << " vertices ("
+                  << bufSize / (1024 * 1024) << " MiB)" << std::endl;
+        std::cout << "memory          ms/frame    Mverts/s" << std::endl;
+
+        // Measures the whole strip, so culling is off for the run
+        VkBuffer savedBuffer = terrainVertexBuffer;
+        uint32_t savedCount = terrainVertexCount;
+        CullBuckets savedBuckets = terrainBuckets;
+        terrainBuckets = CullBuckets::whole(SEGMENTS + 1);
+        for (bool deviceLocal : {false, true}) {
+            VkBuffer buffer;
+            MemoryAllocation memory;
+            if (deviceLocal) {
+                beginStaticUploads();
+                createStaticBuffer(verts.data(), bufSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, buffer, memory);
+                endStaticUploads();
+            } else {
+                createBuffer(bufSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             buffer, memory);
+                uploadBuffer(buffer, memory, verts.data(), bufSize);
+            }
+            terrainVertexBuffer = buffer;
+            terrainVertexCount = static_cast<uint32_t>(verts.size());
+            invalidateStaticPasses();
+
+            for (int i = 0; i < WARMUP_FRAMES; i++) drawFrame();
+            vkDeviceWaitIdle(device);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < BENCH_FRAMES; i++) {
+                glfwPollEvents();
+                drawFrame();
+            }
+            vkDeviceWaitIdle(device);
+            double seconds = std::chrono::duration<double>(
+                std::chrono::high_resolution_clock::now() - start).count();
+
+            std::printf("%-14s %9.3f %11.1f\n", deviceLocal ? "device-local" : "host-visible",
+                seconds * 1000.0 / BENCH_FRAMES,
+                static_cast<double>(terrainVertexCount) * BENCH_FRAMES / seconds / 1e6);
+            destroyBuffer(buffer, memory);
+        }
+        terrainVertexBuffer = savedBuffer;
+        terrainVertexCount = savedCount;
+        terrainBuckets = savedBuckets;
+        invalidateStaticPasses();
+    }
+
     // ------------------------------------------------------------------------------------
     // drawFrame function
     // ------------------------------------------------------------------------------------
 
     void drawFrame() {
-        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        waitForFrameSlot();
+        releaseRetiredSwapchains(false);
+        collectCapture(currentFrame);
 
         uint32_t imageIndex;
-        VkResult result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX,
-            imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+        VkResult result;
+        if (headless()) {
+            imageIndex = currentFrame;   // each slot renders into its own offscreen image
+            result = VK_SUCCESS;
+        } else {
+            PROFILE_SCOPE("acquireNextImage");
+            result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX,
+                imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+        }
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR) {
             recreateSwapchain();
@@ -1169,41 +3848,101 @@ private:
             throw std::runtime_error("Failed to acquire swapchain image");
         }
 
-        vkResetFences(device, 1, &inFlightFences[currentFrame]);
-
+        readGpuTimestamps(currentFrame);
+        resetFrameRing(currentFrame);
+        prepareFrameData();
+        recordPasses();
+        beginCapture();
         vkResetCommandBuffer(commandBuffers[currentFrame], 0);
         recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
 
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-        VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.waitSemaphoreCount = 1;
+        // Headless has no acquire to wait for and no present to signal
+        VkSemaphore waitSemaphores[2];
+        VkPipelineStageFlags waitStages[2];
+        uint32_t waitCount = 0;
+        if (!headless()) {
+            waitSemaphores[waitCount] = imageAvailableSemaphores[currentFrame];
+            waitStages[waitCount++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        }
+        if (uploadSemaphorePending) {
+            waitSemaphores[waitCount] = uploadSemaphore;
+            waitStages[waitCount++] = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+        }
+        submitInfo.waitSemaphoreCount = waitCount;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
 
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 
-        VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-        submitInfo.signalSemaphoreCount = 1;
+        VkSemaphore signalSemaphores[] = {frameTimeline, renderFinishedSemaphores[currentFrame]};
+        submitInfo.signalSemaphoreCount = headless() ? 1 : 2;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
-        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
-            throw std::runtime_error("Failed to submit draw command buffer");
+        // Values for the binary semaphores are ignored
+        uint64_t waitValues[2] = {};
+        uint64_t signalValues[] = {frameNumber + 1, 0};
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = waitCount;
+        timelineInfo.pWaitSemaphoreValues = waitValues;
+        timelineInfo.signalSemaphoreValueCount = submitInfo.signalSemaphoreCount;
+        timelineInfo.pSignalSemaphoreValues = signalValues;
+        submitInfo.pNext = &timelineInfo;
+
+        {
+            PROFILE_SCOPE("queueSubmit");
+            if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+                throw std::runtime_error("Failed to submit draw command buffer");
+        }
+        timestampFrame[currentFrame] = frameNumber + 1;
+        slotCaptures[currentFrame].frame = frameNumber;
+        frameNumber++;
+        if (inputSampleTime.time_since_epoch().count() != 0) {
+            submitLatencyMs.push_back(std::chrono::duration<float, std::milli>(
+                std::chrono::steady_clock::now() - inputSampleTime).count());
+        }
+        uploadSemaphorePending = false;
+        finishStaticUploads(false);
+
+        if (headless()) {
+            currentFrame = (currentFrame + 1) % options.framesInFlight;
+            return;
+        }
 
         VkPresentInfoKHR presentInfo{};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
         presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = signalSemaphores;
+        presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
 
         VkSwapchainKHR swapchains[] = {swapchain};
         presentInfo.swapchainCount = 1;
         presentInfo.pSwapchains = swapchains;
         presentInfo.pImageIndices = &imageIndex;
 
-        result = vkQueuePresentKHR(presentQueue, &presentInfo);
+        // presentID = frameNumber, so the sample time can be found when the timing comes back
+        VkPresentTimeGOOGLE presentTime{static_cast<uint32_t>(frameNumber), 0};
+        VkPresentTimesInfoGOOGLE presentTimes{};
+        if (getPastPresentationTiming) {
+            presentSampleTimes[frameNumber % LATENCY_HISTORY] = inputSampleTime;
+            presentTimes.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+            presentTimes.swapchainCount = 1;
+            presentTimes.pTimes = &presentTime;
+            presentInfo.pNext = &presentTimes;
+        }
+
+        {
+            PROFILE_SCOPE("queuePresent");
+            result = vkQueuePresentKHR(presentQueue, &presentInfo);
+        }
+        collectPresentTimings();
+        if (frameNumber == 1) {
+            std::printf("Time to first frame: %.1f ms\n", std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - startTime).count());
+        }
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
             framebufferResized = false;
             recreateSwapchain();
@@ -1211,7 +3950,7 @@ private:
             throw std::runtime_error("Failed to present swapchain image");
         }
 
-        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        currentFrame = (currentFrame + 1) % options.framesInFlight;
     }
 
     // ------------------------------------------------------------------------------------
@@ -1221,6 +3960,8 @@ private:
     bool isDeviceSuitable(VkPhysicalDevice dev) {
         auto indices = findQueueFamilies(dev);
         if (!indices.isComplete()) return false;
+        if (!supportsTimelineSemaphores(dev)) return false;
+        if (headless()) return true;   // any graphics queue, CPU implementations included
 
         uint32_t extCount;
         vkEnumerateDeviceExtensionProperties(dev, nullptr, &extCount, nullptr);
@@ -1241,6 +3982,20 @@ private:
         return !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
 
+    bool supportsTimelineSemaphores(VkPhysicalDevice dev) {
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(dev, &props);
+        if (props.apiVersion < VK_API_VERSION_1_2) return false;
+
+        VkPhysicalDeviceVulkan12Features features12{};
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &features12;
+        vkGetPhysicalDeviceFeatures2(dev, &features);
+        return features12.timelineSemaphore == VK_TRUE;
+    }
+
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice dev) {
         QueueFamilyIndices indices;
         uint32_t count = 0;
@@ -1252,13 +4007,26 @@ private:
             if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
                 indices.graphicsFamily = i;
 
+            // Headless never presents; the graphics family stands in
             VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(dev, i, surface, &presentSupport);
+            if (surface)
+                vkGetPhysicalDeviceSurfaceSupportKHR(dev, i, surface, &presentSupport);
+            else
+                presentSupport = indices.graphicsFamily.has_value();
             if (presentSupport)
                 indices.presentFamily = i;
 
             if (indices.isComplete()) break;
         }
+
+        // Transfer-only families map to the copy engine on discrete GPUs
+        for (uint32_t i = 0; i < count; i++) {
+            if ((families[i].queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+                !(families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+                indices.transferFamily = i;
+                break;
+            }
+        }
         return indices;
     }
 
@@ -1296,9 +4064,23 @@ private:
     }
 
     VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& modes) {
-        for (auto mode : modes) {
-            if (mode == VK_PRESENT_MODE_MAILBOX_KHR) return mode;
+        auto supported = [&](VkPresentModeKHR mode) {
+            return std::find(modes.begin(), modes.end(), mode) != modes.end();
+        };
+        VkPresentModeKHR wanted = VK_PRESENT_MODE_FIFO_KHR;
+        switch (options.presentMode) {
+        case PresentMode::Auto:
+            // Benchmarks want uncapped frame rates
+            if ((options.benchSprites || options.benchTerrain) && supported(VK_PRESENT_MODE_IMMEDIATE_KHR))
+                return VK_PRESENT_MODE_IMMEDIATE_KHR;
+            return supported(VK_PRESENT_MODE_MAILBOX_KHR) ? VK_PRESENT_MODE_MAILBOX_KHR : VK_PRESENT_MODE_FIFO_KHR;
+        case PresentMode::Fifo: return VK_PRESENT_MODE_FIFO_KHR;
+        case PresentMode::Mailbox: wanted = VK_PRESENT_MODE_MAILBOX_KHR; break;
+        case PresentMode::Immediate: wanted = VK_PRESENT_MODE_IMMEDIATE_KHR; break;
         }
+        if (supported(wanted)) return wanted;
+        // FIFO is the one mode every implementation has
+        std::cerr << "Present mode " << presentModeName(wanted) << " unsupported, using fifo" << std::endl;
         return VK_PRESENT_MODE_FIFO_KHR;
     }
 
@@ -1316,68 +4098,61 @@ private:
     // pipeline helper functions
     // ------------------------------------------------------------------------------------
 
-    VkShaderModule createShaderModule(const std::vector<char>& code) {
+    // Shaders come from the binary unless --shader-dir points at freshly compiled ones
+    VkShaderModule loadShaderModule(const std::string& name) {
+        if (!options.shaderDir.empty()) {
+            auto code = readSpirv(options.shaderDir + "/" + name);
+            return createShaderModule(code.data(), code.size() * sizeof(uint32_t));
+        }
+        for (const auto& shader : EMBEDDED_SHADERS) {
+            if (name == shader.name) return createShaderModule(shader.code, shader.size);
+        }
+        throw std::runtime_error("Shader not embedded: " + name);
+    }
+
+    VkShaderModule createShaderModule(const uint32_t* code, size_t size) {
         VkShaderModuleCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+        createInfo.codeSize = size;
+        createInfo.pCode = code;
         VkShaderModule module;
         if (vkCreateShaderModule(device, &createInfo, nullptr, &module) != VK_SUCCESS)
             throw std::runtime_error("Failed to create shader module");
         return module;
     }
 
-    VkPipeline createPipeline(
-        const std::string& vertPath, const std::string& fragPath,
-        const std::vector<VkVertexInputBindingDescription>& bindings,
-        const std::vector<VkVertexInputAttributeDescription>& attributes,
-        VkPrimitiveTopology topology,
-        bool enableBlending = false
-    ) {
-        auto vertCode = readFile(vertPath);
-        auto fragCode = readFile(fragPath);
-        VkShaderModule vertModule = createShaderModule(vertCode);
-        VkShaderModule fragModule = createShaderModule(fragCode);
-
-        VkPipelineShaderStageCreateInfo vertStage{};
-        vertStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        vertStage.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        vertStage.module = vertModule;
-        vertStage.pName = "main";
-
-        VkPipelineShaderStageCreateInfo fragStage{};
-        fragStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        fragStage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        fragStage.module = fragModule;
-        fragStage.pName = "main";
-
-        VkPipelineShaderStageCreateInfo stages[] = {vertStage, fragStage};
-
-        VkPipelineVertexInputStateCreateInfo vertexInput{};
-        vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInput.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
-        vertexInput.pVertexBindingDescriptions = bindings.data();
-        vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
-        vertexInput.pVertexAttributeDescriptions = attributes.data();
-
-        VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        inputAssembly.topology = topology;
-        inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-        VkViewport viewport{};
-        viewport.width = static_cast<float>(swapchainExtent.width);
-        viewport.height = static_cast<float>(swapchainExtent.height);
-        viewport.maxDepth = 1.0f;
-        VkRect2D scissor{};
-        scissor.extent = swapchainExtent;
+    // Reads SPIR-V and creates shader modules on the worker pool, then gives each
+    // worker one contiguous slice of the pipelines to build in a single
+    // vkCreateGraphicsPipelines call. The pipeline cache is internally synchronized.
+    void createPipelineBatch(const std::vector<PipelineDesc>& descs) {
+        size_t count = descs.size();
+        std::vector<VkShaderModule> modules(count * 2, VK_NULL_HANDLE);
+        std::vector<std::exception_ptr> errors(count * 2);
+        workers.parallelFor(count * 2, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                try {
+                    const PipelineDesc& d = descs[i / 2];
+                    modules[i] = loadShaderModule(i % 2 ? d.fragShader : d.vertShader);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            }
+        });
+        auto destroyModules = [&] {
+            for (auto m : modules) vkDestroyShaderModule(device, m, nullptr);
+        };
+        for (auto& e : errors) {
+            if (e) {
+                destroyModules();
+                std::rethrow_exception(e);
+            }
+        }
 
+        // State shared by every pipeline
         VkPipelineViewportStateCreateInfo viewportState{};
         viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-        viewportState.viewportCount = 1;
-        viewportState.pViewports = &viewport;
+        viewportState.viewportCount = 1;   // viewport and scissor are dynamic
         viewportState.scissorCount = 1;
-        viewportState.pScissors = &scissor;
 
         VkPipelineRasterizationStateCreateInfo rasterizer{};
         rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -1390,23 +4165,24 @@ private:
         multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
         multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
-        VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-                                               VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        if (enableBlending) {
-            colorBlendAttachment.blendEnable = VK_TRUE;
-            colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-            colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-            colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-            colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-            colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-            colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-        }
-
-        VkPipelineColorBlendStateCreateInfo colorBlending{};
-        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-        colorBlending.attachmentCount = 1;
-        colorBlending.pAttachments = &colorBlendAttachment;
+        VkPipelineColorBlendAttachmentState opaqueAttachment{};
+        opaqueAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                          VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        VkPipelineColorBlendAttachmentState blendAttachment = opaqueAttachment;
+        blendAttachment.blendEnable = VK_TRUE;
+        blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+        VkPipelineColorBlendStateCreateInfo opaqueBlending{};
+        opaqueBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        opaqueBlending.attachmentCount = 1;
+        opaqueBlending.pAttachments = &opaqueAttachment;
+        VkPipelineColorBlendStateCreateInfo alphaBlending = opaqueBlending;
+        alphaBlending.pAttachments = &blendAttachment;
 
         VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
         VkPipelineDynamicStateCreateInfo dynamicState{};
@@ -1414,28 +4190,68 @@ private:
         dynamicState.dynamicStateCount = 2;
         dynamicState.pDynamicStates = dynamicStates;
 
-        VkGraphicsPipelineCreateInfo pipelineInfo{};
-        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipelineInfo.stageCount = 2;
-        pipelineInfo.pStages = stages;
-        pipelineInfo.pVertexInputState = &vertexInput;
-        pipelineInfo.pInputAssemblyState = &inputAssembly;
-        pipelineInfo.pViewportState = &viewportState;
-        pipelineInfo.pRasterizationState = &rasterizer;
-        pipelineInfo.pMultisampleState = &multisampling;
-        pipelineInfo.pColorBlendState = &colorBlending;
-        pipelineInfo.pDynamicState = &dynamicState;
-        pipelineInfo.layout = pipelineLayout;
-        pipelineInfo.renderPass = renderPass;
-        pipelineInfo.subpass = 0;
-
-        VkPipeline pipeline;
-        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
-            throw std::runtime_error("Failed to create graphics pipeline");
+        // Per-pipeline state; sized up front so the create infos can point into it
+        std::vector<std::array<VkPipelineShaderStageCreateInfo, 2>> stages(count);
+        std::vector<VkPipelineVertexInputStateCreateInfo> vertexInputs(count);
+        std::vector<VkPipelineInputAssemblyStateCreateInfo> inputAssemblies(count);
+        std::vector<VkGraphicsPipelineCreateInfo> pipelineInfos(count);
+        for (size_t i = 0; i < count; i++) {
+            const PipelineDesc& d = descs[i];
+            for (int s = 0; s < 2; s++) {
+                stages[i][s] = {};
+                stages[i][s].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                stages[i][s].stage = s ? VK_SHADER_STAGE_FRAGMENT_BIT : VK_SHADER_STAGE_VERTEX_BIT;
+                stages[i][s].module = modules[i * 2 + s];
+                stages[i][s].pName = "main";
+            }
+
+            VkPipelineVertexInputStateCreateInfo& vertexInput = vertexInputs[i];
+            vertexInput = {};
+            vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+            vertexInput.vertexBindingDescriptionCount = static_cast<uint32_t>(d.bindings.size());
+            vertexInput.pVertexBindingDescriptions = d.bindings.data();
+            vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(d.attributes.size());
+            vertexInput.pVertexAttributeDescriptions = d.attributes.data();
+
+            VkPipelineInputAssemblyStateCreateInfo& inputAssembly = inputAssemblies[i];
+            inputAssembly = {};
+            inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+            inputAssembly.topology = d.topology;
+            inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+            VkGraphicsPipelineCreateInfo& pipelineInfo = pipelineInfos[i];
+            pipelineInfo = {};
+            pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+            pipelineInfo.stageCount = 2;
+            pipelineInfo.pStages = stages[i].data();
+            pipelineInfo.pVertexInputState = &vertexInput;
+            pipelineInfo.pInputAssemblyState = &inputAssembly;
+            pipelineInfo.pViewportState = &viewportState;
+            pipelineInfo.pRasterizationState = &rasterizer;
+            pipelineInfo.pMultisampleState = &multisampling;
+            pipelineInfo.pColorBlendState = d.enableBlending ? &alphaBlending : &opaqueBlending;
+            pipelineInfo.pDynamicState = &dynamicState;
+            pipelineInfo.layout = pipelineLayout;
+            pipelineInfo.renderPass = renderPass;
+            pipelineInfo.subpass = 0;
+        }
 
-        vkDestroyShaderModule(device, vertModule, nullptr);
-        vkDestroyShaderModule(device, fragModule, nullptr);
-        return pipeline;
+        std::vector<VkPipeline> pipelines(count, VK_NULL_HANDLE);
+        std::atomic<bool> failed{false};
+        size_t slice = (count + workers.size() - 1) / workers.size();
+        workers.parallelFor(count, slice, [&](size_t begin, size_t end) {
+            if (vkCreateGraphicsPipelines(device, pipelineCache, static_cast<uint32_t>(end - begin),
+                    &pipelineInfos[begin], nullptr, &pipelines[begin]) != VK_SUCCESS)
+                failed = true;
+        });
+        destroyModules();
+
+        if (failed) {
+            for (auto p : pipelines) vkDestroyPipeline(device, p, nullptr);
+            throw std::runtime_error("Failed to create graphics pipeline");
+        }
+        for (size_t i = 0; i < count; i++)
+            *descs[i].target = pipelines[i];
     }
 
     // ------------------------------------------------------------------------------------
@@ -1444,28 +4260,31 @@ private:
 
     void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                       VkMemoryPropertyFlags properties,
-                      VkBuffer& buffer, VkDeviceMemory& memory) {
+                      VkBuffer& buffer, MemoryAllocation& memory,
+                      bool sharedWithTransfer = false) {
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size;
         bufferInfo.usage = usage;
         bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+        // Written on the transfer queue, read on the graphics queue: CONCURRENT avoids
+        // queue family ownership transfers for data that is copied once
+        uint32_t families[] = {queueFamilies.graphicsFamily.value(), uploadFamily()};
+        if (sharedWithTransfer && families[0] != families[1]) {
+            bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            bufferInfo.queueFamilyIndexCount = 2;
+            bufferInfo.pQueueFamilyIndices = families;
+        }
+
         if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
             throw std::runtime_error("Failed to create buffer");
 
         VkMemoryRequirements memReqs;
         vkGetBufferMemoryRequirements(device, buffer, &memReqs);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memReqs.memoryTypeBits, properties);
-
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
-            throw std::runtime_error("Failed to allocate buffer memory");
-
-        vkBindBufferMemory(device, buffer, memory, 0);
+        memory = memoryAllocator.allocate(memReqs, findMemoryType(memReqs.memoryTypeBits, properties));
+        vkBindBufferMemory(device, buffer, memory.memory, memory.offset);
     }
 
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
@@ -1479,23 +4298,219 @@ private:
         throw std::runtime_error("Failed to find suitable memory type");
     }
 
-    void uploadBuffer(VkBuffer /*buffer*/, VkDeviceMemory memory,
+    // Host-visible allocations are persistently mapped by the allocator
+    void uploadBuffer(VkBuffer /*buffer*/, const MemoryAllocation& memory,
                       const void* data, VkDeviceSize size) {
-        void* mapped;
-        vkMapMemory(device, memory, 0, size, 0, &mapped);
-        memcpy(mapped, data, static_cast<size_t>(size));
-        vkUnmapMemory(device, memory);
+        memcpy(memory.mapped, data, static_cast<size_t>(size));
+    }
+
+    uint32_t uploadFamily() const {
+        return queueFamilies.transferFamily.value_or(queueFamilies.graphicsFamily.value());
+    }
+
+    void beginStaticUploads() {
+        finishStaticUploads(true);
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkResetCommandBuffer(uploadCmd, 0);
+        vkBeginCommandBuffer(uploadCmd, &beginInfo);
+    }
+
+    // Records a staging copy into a new DEVICE_LOCAL buffer; call between
+    // beginStaticUploads() and endStaticUploads()
+    void createStaticBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage,
+                            VkBuffer& buffer, MemoryAllocation& memory) {
+        VkBuffer staging;
+        MemoryAllocation stagingMemory;
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     staging, stagingMemory);
+        uploadBuffer(staging, stagingMemory, data, size);
+        stagingBuffers.push_back({staging, stagingMemory});
+
+        createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory, true);
+
+        VkBufferCopy region{};
+        region.size = size;
+        vkCmdCopyBuffer(uploadCmd, staging, buffer, 1, &region);
+    }
+
+    // Same as createStaticBuffer for a sampled 2D image. The final transition runs on
+    // the upload queue, which may lack fragment stages; uploadSemaphore orders the reads.
+    void createStaticImage(const void* pixels, uint32_t width, uint32_t height, VkFormat format,
+                           uint32_t bytesPerPixel, VkImage& image, MemoryAllocation& memory) {
+        VkDeviceSize size = VkDeviceSize(width) * height * bytesPerPixel;
+        VkBuffer staging;
+        MemoryAllocation stagingMemory;
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     staging, stagingMemory);
+        uploadBuffer(staging, stagingMemory, pixels, size);
+        stagingBuffers.push_back({staging, stagingMemory});
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = format;
+        imageInfo.extent = {width, height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        uint32_t families[] = {queueFamilies.graphicsFamily.value(), uploadFamily()};
+        if (families[0] != families[1]) {
+            imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            imageInfo.queueFamilyIndexCount = 2;
+            imageInfo.pQueueFamilyIndices = families;
+        }
+        if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create image");
+
+        VkMemoryRequirements memReqs;
+        vkGetImageMemoryRequirements(device, image, &memReqs);
+        memory = memoryAllocator.allocate(memReqs,
+            findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT), false);
+        vkBindImageMemory(device, image, memory.memory, memory.offset);
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(uploadCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        VkBufferImageCopy region{};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = {width, height, 1};
+        vkCmdCopyBufferToImage(uploadCmd, staging, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(uploadCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    // Submits the recorded copies. The next drawFrame() waits on uploadSemaphore at
+    // vertex input, so init never blocks on the copy engine.
+    void endStaticUploads() {
+        if (vkEndCommandBuffer(uploadCmd) != VK_SUCCESS)
+            throw std::runtime_error("Failed to record upload command buffer");
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &uploadCmd;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &uploadSemaphore;
+        if (vkQueueSubmit(transferQueue, 1, &submitInfo, uploadFence) != VK_SUCCESS)
+            throw std::runtime_error("Failed to submit static uploads");
+        uploadSemaphorePending = true;
+        uploadInFlight = true;
+    }
+
+    // Frees staging memory once the copies are done; polls unless wait is set
+    void finishStaticUploads(bool wait) {
+        if (!uploadInFlight) return;
+        if (wait)
+            vkWaitForFences(device, 1, &uploadFence, VK_TRUE, UINT64_MAX);
+        else if (vkGetFenceStatus(device, uploadFence) != VK_SUCCESS)
+            return;
+
+        for (auto& [buffer, memory] : stagingBuffers)
+            destroyBuffer(buffer, memory);
+        stagingBuffers.clear();
+        vkResetFences(device, 1, &uploadFence);
+        uploadInFlight = false;
+
+        // Nothing consumed the semaphore (cleanup before the first frame); drain it
+        if (uploadSemaphorePending) {
+            VkPipelineStageFlags stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            VkSubmitInfo submitInfo{};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.waitSemaphoreCount = 1;
+            submitInfo.pWaitSemaphores = &uploadSemaphore;
+            submitInfo.pWaitDstStageMask = &stage;
+            vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+            vkQueueWaitIdle(graphicsQueue);
+            uploadSemaphorePending = false;
+        }
+    }
+
+    void createFrameRing() {
+        static_assert(sizeof(ParticleVertex) * MAX_PARTICLES < FRAME_RING_REGION_SIZE,
+                      "frame ring region must hold a full particle upload");
+        createBuffer(FRAME_RING_REGION_SIZE * MAX_FRAMES_IN_FLIGHT,
+                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     frameRingBuffer, frameRingMemory);
+        frameRingMapped = static_cast<uint8_t*>(frameRingMemory.mapped);
+
+        // Each region starts with its CameraUniforms and static draw list, so their offsets
+        // never move and pre-recorded passes can keep their descriptor set and indirect offsets
+        std::array<VkDescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> layouts;
+        layouts.fill(cameraSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+        allocInfo.pSetLayouts = layouts.data();
+        if (vkAllocateDescriptorSets(device, &allocInfo, cameraDescriptorSets.data()) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate camera descriptor sets");
+
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            VkDescriptorBufferInfo bufferInfo{frameRingBuffer, FRAME_RING_REGION_SIZE * i, sizeof(CameraUniforms)};
+            VkWriteDescriptorSet write{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = cameraDescriptorSets[i];
+            write.dstBinding = 0;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            write.pBufferInfo = &bufferInfo;
+            vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+        }
     }
 
-    void destroyBuffer(VkBuffer& buffer, VkDeviceMemory& memory) {
+    // Call once waitForFrameSlot() has returned; frees everything the slot handed out
+    // options.framesInFlight frames ago
+    void resetFrameRing(uint32_t frame) {
+        frameRingHead = FRAME_RING_REGION_SIZE * frame;
+        frameRingEnd = frameRingHead + FRAME_RING_REGION_SIZE;
+
+        FrameAllocation camera = allocateFrameData(sizeof(CameraUniforms));
+        static_cast<CameraUniforms*>(camera.data)->viewProj = getProjectionMatrix();
+        staticDraws = allocateFrameData(sizeof(VkDrawIndirectCommand) * STATIC_DRAW_COUNT);
+    }
+
+    FrameAllocation allocateFrameData(VkDeviceSize size, VkDeviceSize alignment = FRAME_RING_ALIGNMENT) {
+        VkDeviceSize offset = (frameRingHead + alignment - 1) / alignment * alignment;
+        if (offset + size > frameRingEnd)
+            throw std::runtime_error("Frame ring region exhausted");
+        frameRingHead = offset + size;
+        return {frameRingBuffer, offset, frameRingMapped + offset};
+    }
+
+    void destroyBuffer(VkBuffer& buffer, MemoryAllocation& memory) {
         if (buffer != VK_NULL_HANDLE) {
             vkDestroyBuffer(device, buffer, nullptr);
             buffer = VK_NULL_HANDLE;
         }
-        if (memory != VK_NULL_HANDLE) {
-            vkFreeMemory(device, memory, nullptr);
-            memory = VK_NULL_HANDLE;
-        }
+        memoryAllocator.free(memory);
     }
 
     // ------------------------------------------------------------------------------------
@@ -1511,42 +4526,92 @@ private:
             glfwWaitEvents();
         }
 
-        vkDeviceWaitIdle(device);
-        cleanupSwapchain();
-
-        // Pipelines depend on swapchain extent, so rebuild them too
-        vkDestroyPipeline(device, landerPipeline, nullptr);
+        // Frames in flight may still render into the old images, so park them instead
+        // of idling the device. Pipelines use dynamic viewport/scissor and survive as-is.
+        retiredSwapchains.push_back({swapchain, std::move(swapchainImageViews),
+                                     std::move(swapchainFramebuffers), frameNumber});
+        swapchainImageViews.clear();
+        swapchainFramebuffers.clear();
 
+        VkFormat oldFormat = swapchainImageFormat;
         createSwapchain();
         createImageViews();
-        createPipelines();
+
+        // The render pass (and so every pipeline) bakes in the color format, which a
+        // surface change such as moving to an HDR monitor can alter
+        if (swapchainImageFormat != oldFormat) {
+            vkDeviceWaitIdle(device);
+            destroyPipelines();
+            vkDestroyRenderPass(device, renderPass, nullptr);
+            createRenderPass();
+            createPipelines();
+        }
         createFramebuffers();
+        invalidateStaticPasses();   // viewport, scissor and sprite scale follow the extent
+    }
+
+    // Frames before retiredAt used the swapchain, and the last of them signals retiredAt.
+    // Its present may still be queued then, so keep the swapchain framesInFlight frames longer.
+    void releaseRetiredSwapchains(bool all) {
+        auto done = [&](const RetiredSwapchain& r) {
+            return all || r.retiredAt + options.framesInFlight <= completedFrames;
+        };
+        for (auto& r : retiredSwapchains) {
+            if (!done(r)) continue;
+            for (auto fb : r.framebuffers) vkDestroyFramebuffer(device, fb, nullptr);
+            for (auto iv : r.imageViews) vkDestroyImageView(device, iv, nullptr);
+            vkDestroySwapchainKHR(device, r.swapchain, nullptr);
+        }
+        retiredSwapchains.erase(std::remove_if(retiredSwapchains.begin(), retiredSwapchains.end(), done),
+                                retiredSwapchains.end());
+    }
+
+    void destroyPipelines() {
+        for (VkPipeline* p : {&landerPipeline, &landerInstancedPipeline, &terrainPipeline, &starsPipeline, &starsQuadPipeline,
+                              &particlePipeline, &particleQuadPipeline, &hudPipeline}) {
+            vkDestroyPipeline(device, *p, nullptr);
+            *p = VK_NULL_HANDLE;
+        }
     }    
 
     void cleanupSwapchain() {
         for (auto fb : swapchainFramebuffers) vkDestroyFramebuffer(device, fb, nullptr);
         for (auto iv : swapchainImageViews) vkDestroyImageView(device, iv, nullptr);
-        vkDestroySwapchainKHR(device, swapchain, nullptr);
+        swapchainFramebuffers.clear();
+        swapchainImageViews.clear();
     }
 
-    void recordCommandBuffer(VkCommandBuffer cmd, uint32_t imageIndex) {
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        vkBeginCommandBuffer(cmd, &beginInfo);
+    // Tint by state: flying white, landed green, crashed red
+    static LanderInstance makeLanderInstance(glm::vec2 pos, float angle, SimState state) {
+        switch (state) {
+        case SimState::Landed:  return {pos, angle, {77, 255, 77, 255}};
+        case SimState::Crashed: return {pos, angle, {255, 77, 77, 255}};
+        default:                return {pos, angle, {255, 255, 255, 255}};
+        }
+    }
 
-        VkRenderPassBeginInfo rpBegin{};
-        rpBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        rpBegin.renderPass = renderPass;
-        rpBegin.framebuffer = swapchainFramebuffers[imageIndex];
-        rpBegin.renderArea.offset = {0, 0};
-        rpBegin.renderArea.extent = swapchainExtent;
+    // One vertex per sprite for points, or a 4-corner strip instanced per sprite for quads
+    void drawSprites(VkCommandBuffer cmd, uint32_t count) {
+        if (options.spriteMode == SpriteMode::Quads)
+            vkCmdDraw(cmd, 4, count, 0, 0);
+        else
+            vkCmdDraw(cmd, count, 1, 0, 0);
+    }
 
-        VkClearValue clearColor = {{{0.01f, 0.01f, 0.03f, 1.0f}}};
-        rpBegin.clearValueCount = 1;
-        rpBegin.pClearValues = &clearColor;
+    // Any secondary is valid in any slot's render pass instance, so framebuffer is left unset
+    void beginSecondary(VkCommandBuffer cmd) {
+        VkCommandBufferInheritanceInfo inheritance{};
+        inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance.renderPass = renderPass;
+        inheritance.subpass = 0;
 
-        vkCmdBeginRenderPass(cmd, &rpBegin, VK_SUBPASS_CONTENTS_INLINE);
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        beginInfo.pInheritanceInfo = &inheritance;
+        vkBeginCommandBuffer(cmd, &beginInfo);
 
+        // Dynamic state is not inherited from the primary
         VkViewport viewport{};
         viewport.width = static_cast<float>(swapchainExtent.width);
         viewport.height = static_cast<float>(swapchainExtent.height);
@@ -1557,143 +4622,483 @@ private:
         scissor.extent = swapchainExtent;
         vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-        glm::mat4 proj = getProjectionMatrix();
+        // Set 0 is the camera of the frame slot this buffer belongs to
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+                                0, 1, &cameraDescriptorSets[currentFrame], 0, nullptr);
+    }
+
+    // Re-record every slot's static pass before its next use
+    void invalidateStaticPasses() {
+        staticPassDirty.fill(true);
+    }
+
+    // Stars, terrain and landing pad: nothing here changes per frame, the camera comes
+    // from the uniform buffer. Re-recorded only after invalidateStaticPasses().
+    void recordStaticPass(VkCommandBuffer cmd) {
         PushConstants pc{};
+        // Sprite sizes are in pixels; the quad path needs them in NDC
+        glm::vec4 spriteParams(2.0f / static_cast<float>(swapchainExtent.width),
+                               2.0f / static_cast<float>(swapchainExtent.height), 0.0f, 0.0f);
+        bool quadSprites = options.spriteMode == SpriteMode::Quads;
 
         // --- 1. Stars ---
+        writeGpuTimestamp(cmd, GpuSection::Stars, false);
         if (starsVertexCount > 0) {
-            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, starsPipeline);
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              quadSprites ? starsQuadPipeline : starsPipeline);
             VkBuffer buffers[] = {starsVertexBuffer};
             VkDeviceSize offsets[] = {0};
             vkCmdBindVertexBuffers(cmd, 0, 1, buffers, offsets);
-            pc.mvp = proj;
             pc.color = glm::vec4(1.0f);
+            pc.params = spriteParams;
             vkCmdPushConstants(cmd, pipelineLayout,
                 VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pc), &pc);
-            vkCmdDraw(cmd, starsVertexCount, 1, 0, 0);
+            drawStatic(cmd, StaticDraw::Stars);
         }
+        writeGpuTimestamp(cmd, GpuSection::Stars, true);
 
         // --- 2. Terrain ---
+        writeGpuTimestamp(cmd, GpuSection::Terrain, false);
         if (terrainVertexCount > 0) {
             vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, terrainPipeline);
             VkBuffer buffers[] = {terrainVertexBuffer};
             VkDeviceSize offsets[] = {0};
             vkCmdBindVertexBuffers(cmd, 0, 1, buffers, offsets);
-            pc.mvp = proj;
             pc.color = glm::vec4(0.45f, 0.42f, 0.4f, 1.0f);
+            pc.params = glm::vec4(TERRAIN_CHUNK_ORIGIN, TERRAIN_CHUNK_EXTENT);  // dequantize in shader
             vkCmdPushConstants(cmd, pipelineLayout,
                 VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pc), &pc);
-            vkCmdDraw(cmd, terrainVertexCount, 1, 0, 0);
+            drawStatic(cmd, StaticDraw::Terrain);
         }
+        writeGpuTimestamp(cmd, GpuSection::Terrain, true);
 
         // --- 3. Landing pad ---
+        writeGpuTimestamp(cmd, GpuSection::LandingPad, false);
         {
             vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, landerPipeline);
             VkBuffer buffers[] = {landingPadVertexBuffer};
             VkDeviceSize offsets[] = {0};
             vkCmdBindVertexBuffers(cmd, 0, 1, buffers, offsets);
-            pc.mvp = proj;
             pc.color = glm::vec4(1.0f);
             vkCmdPushConstants(cmd, pipelineLayout,
                 VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pc), &pc);
-            vkCmdDraw(cmd, landingPadVertexCount, 1, 0, 0);
+            drawStatic(cmd, StaticDraw::LandingPad);
         }
+        writeGpuTimestamp(cmd, GpuSection::LandingPad, true);
+    }
 
-        // --- 4. Particles (NEW — dynamic upload each frame) ---
-        {
-            // Collect only active particles into GPU format
-            std::vector<ParticleVertex> activeParticles;
-            for (const auto& p : particles) {
-                if (p.active) {
-                    activeParticles.push_back({
-                        p.pos,
-                        p.life / p.maxLife,  // normalize to 0-1 for shader
-                        p.size
-                    });
-                }
-            }
+    void drawStatic(VkCommandBuffer cmd, StaticDraw draw) {
+        VkDeviceSize offset = staticDraws.offset + sizeof(VkDrawIndirectCommand) * static_cast<size_t>(draw);
+        vkCmdDrawIndirect(cmd, staticDraws.buffer, offset, 1, sizeof(VkDrawIndirectCommand));
+    }
 
-            if (!activeParticles.empty()) {
-                // Upload active subset to pre-allocated buffer
-                uploadBuffer(particleVertexBuffer, particleVertexMemory,
-                    activeParticles.data(),
-                    sizeof(ParticleVertex) * activeParticles.size());
-
-                vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, particlePipeline);
-                VkBuffer buffers[] = {particleVertexBuffer};
-                VkDeviceSize offsets[] = {0};
-                vkCmdBindVertexBuffers(cmd, 0, 1, buffers, offsets);
-                pc.mvp = proj;
-                pc.color = glm::vec4(1.0f);
-                vkCmdPushConstants(cmd, pipelineLayout,
-                    VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pc), &pc);
-                vkCmdDraw(cmd, static_cast<uint32_t>(activeParticles.size()), 1, 0, 0);
-            }
+    // World-space rectangle covered by getProjectionMatrix(): (minX, minY, maxX, maxY)
+    glm::vec4 getViewBounds() const {
+        glm::mat4 invProj = glm::inverse(getProjectionMatrix());
+        glm::vec4 a = invProj * glm::vec4(-1.0f, -1.0f, 0.0f, 1.0f);
+        glm::vec4 b = invProj * glm::vec4(1.0f, 1.0f, 0.0f, 1.0f);
+        return glm::vec4(glm::min(a.x, b.x), glm::min(a.y, b.y), glm::max(a.x, b.x), glm::max(a.y, b.y));
+    }
+
+    // Writes this frame's static draw list: only the buckets overlapping the view are drawn
+    void cullStaticStreams() {
+        glm::vec4 view = getViewBounds();
+        auto* draws = static_cast<VkDrawIndirectCommand*>(staticDraws.data);
+        uint32_t first, end;
+
+        // Stars: pad by the largest sprite so edge stars don't pop
+        float starPad = MAX_STAR_SIZE * (view.z - view.x) / static_cast<float>(swapchainExtent.width);
+        starBuckets.visibleRange(view.x - starPad, view.z + starPad, first, end);
+        VkDrawIndirectCommand& starDraw = draws[static_cast<size_t>(StaticDraw::Stars)];
+        if (options.spriteMode == SpriteMode::Points) {
+            starDraw = {end - first, 1, first, 0};
+        } else {
+            if (!drawIndirectFirstInstance) first = 0;
+            starDraw = {4, end - first, 0, first};
         }
 
-        // --- 5. Lander ---
-        {
-            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, landerPipeline);
-            VkBuffer buffers[] = {landerVertexBuffer};
-            VkDeviceSize offsets[] = {0};
-            vkCmdBindVertexBuffers(cmd, 0, 1, buffers, offsets);
+        // Terrain: one more point on each side keeps the strip segments that cross the edge
+        terrainBuckets.visibleRange(view.x, view.z, first, end);
+        first = first > 0 ? first - 1 : 0;
+        end = std::min(end + 1, terrainBuckets.start.back());
+        draws[static_cast<size_t>(StaticDraw::Terrain)] = {2 * (end - first), 1, 2 * first, 0};
+
+        // Landing pad: one object, drawn or not
+        float padLeft = landingPadX - LANDING_PAD_WIDTH / 2.0f - 0.1f;
+        float padRight = landingPadX + LANDING_PAD_WIDTH / 2.0f + 0.1f;
+        bool padVisible = padRight >= view.x && padLeft <= view.z &&
+                          GROUND_HEIGHT + 0.8f >= view.y && GROUND_HEIGHT <= view.w;
+        draws[static_cast<size_t>(StaticDraw::LandingPad)] = {landingPadVertexCount, padVisible ? 1u : 0u, 0, 0};
+    }
+
+    // Fills the frame ring for every pass: the static draw list, then particle, lander and
+    // HUD data. Data-parallel work runs here, on the main thread, because parallelFor()
+    // cannot nest inside a recording job.
+    void prepareFrameData() {
+        PROFILE_SCOPE("prepareFrameData");
+        frameDraw = {};
+        cullStaticStreams();
+
+        // --- Particles ---
+        if (particleCount > 0) {
+            // Positions are quantized inside a camera-centered chunk; anything outside
+            // clamps to the chunk edge, which is always off screen
+            glm::vec2 chunkOrigin = cameraPos - glm::vec2(PARTICLE_CHUNK_EXTENT * 0.5f);
+            float invExtent = 1.0f / PARTICLE_CHUNK_EXTENT;
+
+            // Live particles are already packed; convert to GPU format in parallel
+            FrameAllocation alloc = allocateFrameData(sizeof(ParticleVertex) * particleCount);
+            auto* out = static_cast<ParticleVertex*>(alloc.data);
+            workers.parallelFor(particleCount, PARTICLE_BLOCK_SIZE, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    const Particle& p = particles[i];
+                    glm::vec2 n = (p.pos - chunkOrigin) * invExtent;
+                    out[i] = {
+                        {quantizeUnorm16(n.x), quantizeUnorm16(n.y)},
+                        quantizeUnorm8(p.life / p.maxLife),  // normalize to 0-1 for shader
+                        quantizeUnorm8(p.size / MAX_SPRITE_SIZE),
+                        static_cast<uint8_t>(p.kind),
+                        0
+                    };
+                }
+            });
 
-            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(lander.pos, 0.0f));
-            model = glm::rotate(model, -lander.angle, glm::vec3(0.0f, 0.0f, 1.0f));
+            // Chunk-to-world is affine, so it folds into the MVP
+            glm::mat4 chunkToWorld = glm::translate(glm::mat4(1.0f), glm::vec3(chunkOrigin, 0.0f));
+            chunkToWorld = glm::scale(chunkToWorld, glm::vec3(PARTICLE_CHUNK_EXTENT, PARTICLE_CHUNK_EXTENT, 1.0f));
 
-            pc.mvp = proj * model;
+            frameDraw.particles = alloc;
+            frameDraw.particleMvp = getProjectionMatrix() * chunkToWorld;
+            frameDraw.particleCount = static_cast<uint32_t>(particleCount);
+        }
 
-            if (lander.state == SimState::Crashed)
-                pc.color = glm::vec4(1.0f, 0.3f, 0.3f, 1.0f);
-            else if (lander.state == SimState::Landed)
-                pc.color = glm::vec4(0.3f, 1.0f, 0.3f, 1.0f);
-            else
-                pc.color = glm::vec4(1.0f);
+        // --- Landers (player is instance 0, then the fleet) ---
+        {
+            size_t instanceCount = fleet.size() + 1;
+            FrameAllocation alloc = allocateFrameData(sizeof(LanderInstance) * instanceCount);
+            auto* out = static_cast<LanderInstance*>(alloc.data);
+            out[0] = makeLanderInstance(lander.pos, lander.angle, lander.state);
+            workers.parallelFor(fleet.size(), FLEET_BLOCK_SIZE, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                    out[i + 1] = makeLanderInstance(fleet[i].pos, fleet[i].angle, fleet[i].state);
+            });
 
-            vkCmdPushConstants(cmd, pipelineLayout,
-                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pc), &pc);
-            vkCmdDraw(cmd, landerVertexCount, 1, 0, 0);
+            frameDraw.landers = alloc;
+            frameDraw.landerCount = static_cast<uint32_t>(instanceCount);
         }
 
+        // --- HUD ---
         {
-            auto hud = buildHud();
-            if (!hud.vertices.empty()) {
-                uploadBuffer(hudVertexBuffer, hudVertexMemory,
-                    hud.vertices.data(), sizeof(glm::vec2) * hud.vertices.size());
-
-                vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, hudPipeline);
-                VkBuffer buffers[] = {hudVertexBuffer};
-                VkDeviceSize offsets[] = {0};
-                vkCmdBindVertexBuffers(cmd, 0, 1, buffers, offsets);
-
-                // Screen-space orthographic: pixel coords → NDC
-                glm::mat4 screenProj = glm::ortho(
-                    0.0f, static_cast<float>(swapchainExtent.width),
-                    static_cast<float>(swapchainExtent.height), 0.0f,
-                    -1.0f, 1.0f
-                );
-
-                // Draw each bar with its own color via push constants
-                for (size_t i = 0; i < hud.bars.size(); i++) {
-                    pc.mvp = screenProj;
-                    pc.color = hud.barColors[i];
-                    vkCmdPushConstants(cmd, pipelineLayout,
-                        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                        0, sizeof(pc), &pc);
-                    vkCmdDraw(cmd, hud.bars[i].second, 1, hud.bars[i].first, 0);
+            FrameAllocation alloc = allocateFrameData(sizeof(HudVertex) * MAX_HUD_VERTICES);
+            HudBatch hud;
+            hud.vertices = static_cast<HudVertex*>(alloc.data);
+            hud.capacity = MAX_HUD_VERTICES;
+            buildHud(hud);
+
+            frameDraw.hud = alloc;
+            frameDraw.hudVertexCount = hud.count;
+        }
+    }
+
+    void recordParticlePass(VkCommandBuffer cmd) {
+        if (frameDraw.particleCount == 0) return;
+
+        bool quadSprites = options.spriteMode == SpriteMode::Quads;
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          quadSprites ? particleQuadPipeline : particlePipeline);
+        VkBuffer buffers[] = {frameDraw.particles.buffer};
+        VkDeviceSize offsets[] = {frameDraw.particles.offset};
+        vkCmdBindVertexBuffers(cmd, 0, 1, buffers, offsets);
+
+        PushConstants pc{};
+        pc.mvp = frameDraw.particleMvp;
+        pc.color = glm::vec4(1.0f);
+        pc.params = glm::vec4(2.0f / static_cast<float>(swapchainExtent.width),
+                              2.0f / static_cast<float>(swapchainExtent.height), 0.0f, 0.0f);
+        vkCmdPushConstants(cmd, pipelineLayout,
+            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pc), &pc);
+        drawSprites(cmd, frameDraw.particleCount);
+    }
+
+    // Player and fleet in one instanced draw
+    void recordLanderPass(VkCommandBuffer cmd) {
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, landerInstancedPipeline);
+        VkBuffer buffers[] = {landerVertexBuffer, frameDraw.landers.buffer};
+        VkDeviceSize offsets[] = {0, frameDraw.landers.offset};
+        vkCmdBindVertexBuffers(cmd, 0, 2, buffers, offsets);
+
+        PushConstants pc{};
+        pc.color = glm::vec4(1.0f);
+        vkCmdPushConstants(cmd, pipelineLayout,
+            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pc), &pc);
+        vkCmdDraw(cmd, landerVertexCount, frameDraw.landerCount, 0, 0);
+    }
+
+    // One draw, colors per vertex
+    void recordHudPass(VkCommandBuffer cmd) {
+        if (frameDraw.hudVertexCount == 0) return;
+
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, hudPipeline);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+                                1, 1, &hudDescriptorSet, 0, nullptr);
+        VkBuffer buffers[] = {frameDraw.hud.buffer};
+        VkDeviceSize offsets[] = {frameDraw.hud.offset};
+        vkCmdBindVertexBuffers(cmd, 0, 1, buffers, offsets);
+
+        // Screen-space orthographic: pixel coords → NDC
+        glm::mat4 screenProj = glm::ortho(
+            0.0f, static_cast<float>(swapchainExtent.width),
+            static_cast<float>(swapchainExtent.height), 0.0f,
+            -1.0f, 1.0f
+        );
+
+        PushConstants pc{};
+        pc.mvp = screenProj;
+        pc.color = glm::vec4(1.0f);
+        vkCmdPushConstants(cmd, pipelineLayout,
+            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pc), &pc);
+        vkCmdDraw(cmd, frameDraw.hudVertexCount, 1, 0, 0);
+    }
+
+    // One worker job per pass. The static pass is skipped unless invalidated; the others
+    // are recorded every frame. Errors are collected and thrown on the calling thread.
+    void recordPasses() {
+        PROFILE_SCOPE("recordPasses");
+        bool recordStatic = staticPassDirty[currentFrame];
+        std::array<VkResult, DRAW_PASS_COUNT> results;
+        results.fill(VK_SUCCESS);
+
+        workers.parallelFor(DRAW_PASS_COUNT, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                auto pass = static_cast<DrawPass>(i);
+                if (pass == DrawPass::Static && !recordStatic) continue;
+                PROFILE_SCOPE(DRAW_PASS_NAMES[i]);
+
+                vkResetCommandPool(device, passCommandPools[currentFrame][i], 0);
+                VkCommandBuffer cmd = passCommandBuffers[currentFrame][i];
+                beginSecondary(cmd);
+                switch (pass) {
+                case DrawPass::Static:    recordStaticPass(cmd); break;
+                case DrawPass::Particles:
+                    writeGpuTimestamp(cmd, GpuSection::Particles, false);
+                    recordParticlePass(cmd);
+                    writeGpuTimestamp(cmd, GpuSection::Particles, true);
+                    break;
+                case DrawPass::Landers:
+                    writeGpuTimestamp(cmd, GpuSection::Landers, false);
+                    recordLanderPass(cmd);
+                    writeGpuTimestamp(cmd, GpuSection::Landers, true);
+                    break;
+                case DrawPass::Hud:
+                    writeGpuTimestamp(cmd, GpuSection::Hud, false);
+                    recordHudPass(cmd);
+                    writeGpuTimestamp(cmd, GpuSection::Hud, true);
+                    break;
+                default: break;
                 }
+                results[i] = vkEndCommandBuffer(cmd);
+            }
+        });
+
+        for (VkResult result : results)
+            if (result != VK_SUCCESS) throw std::runtime_error("Failed to record draw pass");
+        staticPassDirty[currentFrame] = false;
+    }
+
+    // Begin stamps wait for nothing, end stamps for all prior work, so a section's time
+    // includes any overlap with the one before it
+    void writeGpuTimestamp(VkCommandBuffer cmd, GpuSection section, bool end) {
+        if (!timestampPool) return;
+        uint32_t query = currentFrame * GPU_QUERIES_PER_FRAME + 2 * static_cast<uint32_t>(section) + (end ? 1 : 0);
+        vkCmdWriteTimestamp(cmd, end ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                            timestampPool, query);
+    }
+
+    // Call after waitForFrameSlot(): the results belong to the frame submitted
+    // options.framesInFlight frames ago. No WAIT flag, so this never blocks.
+    void readGpuTimestamps(uint32_t frame) {
+        if (!timestampPool || timestampFrame[frame] == 0) return;
+
+        std::array<uint64_t, 2 * GPU_QUERIES_PER_FRAME> data{};   // value, availability
+        VkResult result = vkGetQueryPoolResults(device, timestampPool, frame * GPU_QUERIES_PER_FRAME,
+            GPU_QUERIES_PER_FRAME, sizeof(data), data.data(), 2 * sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (result != VK_SUCCESS && result != VK_NOT_READY) return;
+
+        bool complete = true;
+        for (size_t i = 0; i < GPU_SECTION_COUNT; i++) {
+            const uint64_t* begin = &data[4 * i];
+            const uint64_t* end = &data[4 * i + 2];
+            if (!begin[1] || !end[1]) {
+                complete = false;   // the HUD keeps the last value
+                continue;
             }
+            uint64_t ticks = ((end[0] & timestampMask) - (begin[0] & timestampMask)) & timestampMask;
+            gpuSectionMs[i] = static_cast<float>(static_cast<double>(ticks) * timestampPeriod * 1e-6);
+        }
+
+        // A CSV row only for frames whose sections were all measured, so it never mixes frames
+        if (gpuProfileCsv.is_open() && complete) {
+            float total = 0.0f;
+            for (float ms : gpuSectionMs) total += ms;
+            gpuProfileCsv << timestampFrame[frame] - 1;
+            for (float ms : gpuSectionMs) gpuProfileCsv << ',' << ms;
+            gpuProfileCsv << ',' << total << '\n';
+        }
+    }
+
+    // Copies the rendered image into the slot's capture buffer. The image leaves the render
+    // pass in its final layout (TRANSFER_SRC headless, PRESENT_SRC otherwise) and goes back
+    // to it afterwards; the buffer barrier makes the copy visible to the host.
+    void recordCapture(VkCommandBuffer cmd, uint32_t imageIndex, VkBuffer buffer) {
+        VkImageLayout finalLayout = headless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                               : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        VkImageMemoryBarrier imageBarrier{};
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        imageBarrier.oldLayout = finalLayout;
+        imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = swapchainImages[imageIndex];
+        imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageBarrier.subresourceRange.levelCount = 1;
+        imageBarrier.subresourceRange.layerCount = 1;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+        VkBufferImageCopy region{};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = {captureExtent.width, captureExtent.height, 1};
+        vkCmdCopyImageToBuffer(cmd, swapchainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               buffer, 1, &region);
+
+        if (finalLayout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+            imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            imageBarrier.dstAccessMask = 0;
+            imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            imageBarrier.newLayout = finalLayout;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
         }
 
+        VkBufferMemoryBarrier bufferBarrier{};
+        bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.buffer = buffer;
+        bufferBarrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                             0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+    }
+
+    void recordCommandBuffer(VkCommandBuffer cmd, uint32_t imageIndex) {
+        PROFILE_SCOPE("recordCommandBuffer");
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        vkBeginCommandBuffer(cmd, &beginInfo);
+
+        // Queries can't be reset inside a render pass, so the secondaries' are reset here
+        if (timestampPool)
+            vkCmdResetQueryPool(cmd, timestampPool, currentFrame * GPU_QUERIES_PER_FRAME, GPU_QUERIES_PER_FRAME);
+
+        VkRenderPassBeginInfo rpBegin{};
+        rpBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        rpBegin.renderPass = renderPass;
+        rpBegin.framebuffer = swapchainFramebuffers[imageIndex];
+        rpBegin.renderArea.offset = {0, 0};
+        rpBegin.renderArea.extent = swapchainExtent;
+
+        VkClearValue clearColor = {{{0.01f, 0.01f, 0.03f, 1.0f}}};
+        rpBegin.clearValueCount = 1;
+        rpBegin.pClearValues = &clearColor;
+
+        vkCmdBeginRenderPass(cmd, &rpBegin, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        const auto& secondaries = passCommandBuffers[currentFrame];
+        vkCmdExecuteCommands(cmd, static_cast<uint32_t>(secondaries.size()), secondaries.data());
         vkCmdEndRenderPass(cmd);
+        int32_t captureBuffer = slotCaptures[currentFrame].buffer;
+        if (captureBuffer >= 0) recordCapture(cmd, imageIndex, captureBuffers[captureBuffer]);
+
         if (vkEndCommandBuffer(cmd) != VK_SUCCESS)
             throw std::runtime_error("Failed to record command buffer");
     }
 };
 
-int main() {
+int main(int argc, char** argv) {
+    AppOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--points") {
+            options.spriteMode = SpriteMode::Points;
+        } else if (arg == "--bench-sprites") {
+            options.benchSprites = true;
+        } else if (arg == "--bench-terrain") {
+            options.benchTerrain = true;
+        } else if (arg == "--bench-particle-sort") {
+            options.benchParticleSort = true;
+        } else if (arg == "--fleet" && i + 1 < argc) {
+            options.fleetSize = std::min<size_t>(std::strtoul(argv[++i], nullptr, 10), MAX_FLEET_SIZE);
+        } else if (arg == "--pipeline-cache" && i + 1 < argc) {
+            options.pipelineCacheDir = argv[++i];
+        } else if (arg == "--shader-dir" && i + 1 < argc) {
+            options.shaderDir = argv[++i];
+        } else if (arg == "--gpu-profile" && i + 1 < argc) {
+            options.gpuProfilePath = argv[++i];
+        } else if (arg == "--gpu-hud") {
+            options.gpuProfileHud = true;
+        } else if (arg == "--headless" && i + 1 < argc) {
+            options.headlessFrames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--output" && i + 1 < argc) {
+            options.outputDir = argv[++i];
+        } else if (arg == "--size" && i + 1 < argc) {
+            unsigned w = 0, h = 0;
+            if (std::sscanf(argv[++i], "%ux%u", &w, &h) != 2 || w == 0 || h == 0) {
+                std::cerr << "--size expects WIDTHxHEIGHT, e.g. 640x360" << std::endl;
+                return EXIT_FAILURE;
+            }
+            options.headlessWidth = w;
+            options.headlessHeight = h;
+        } else if (arg == "--capture" && i + 1 < argc) {
+            options.capturePath = argv[++i];
+        } else if (arg == "--capture-raw") {
+            options.captureRaw = true;
+        } else if (arg == "--present" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "fifo") options.presentMode = PresentMode::Fifo;
+            else if (mode == "mailbox") options.presentMode = PresentMode::Mailbox;
+            else if (mode == "immediate") options.presentMode = PresentMode::Immediate;
+            else {
+                std::cerr << "--present expects fifo, mailbox or immediate" << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--frames-in-flight" && i + 1 < argc) {
+            options.framesInFlight = std::clamp<uint32_t>(
+                static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)), 1, MAX_FRAMES_IN_FLIGHT);
+        } else if (arg == "--fps-limit" && i + 1 < argc) {
+            options.fpsLimit = std::max(0.0, std::strtod(argv[++i], nullptr));
+        } else if (arg == "--cpu-trace" && i + 1 < argc) {
+            options.cpuTracePath = argv[++i];
+#ifndef LUNA_CPU_PROFILER
+            std::cerr << "--cpu-trace ignored: built without LUNA_CPU_PROFILER" << std::endl;
+#endif
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            std::cerr << "Usage: luna-toy [--points] [--bench-sprites] [--bench-terrain] [--bench-particle-sort] [--fleet N]"
+                         " [--pipeline-cache DIR] [--shader-dir DIR] [--gpu-profile CSV] [--gpu-hud]"
+                         " [--cpu-trace JSON] [--headless N] [--output DIR] [--size WxH]"
+                         " [--capture FILE|-] [--capture-raw] [--present fifo|mailbox|immediate]"
+                         " [--frames-in-flight N] [--fps-limit FPS]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
     try {
-        LunaApp app;
+        LunaApp app(options);
         app.run();
     } catch (const std::exception& e) {
         std::cerr << "Fatal error: " << e.what() << std::endl;